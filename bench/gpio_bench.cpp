@@ -0,0 +1,90 @@
+#include <cstdint>
+
+#include "minisamd21/FastPin.hpp"
+#include "minisamd21/Pin.hpp"
+#include "minisamd21/System.hpp"
+#include "samd21.h"
+
+// GPIO toggle rate benchmark
+//
+// Toggles the LED pin through each access path and stores the toggles per second
+// in gpio_bench_results, read them with the debugger (or watch the pin on a scope).
+// Build with: cmake --build build --target gpio_bench
+
+constexpr uint8_t LED_PIN = 23;
+constexpr uint32_t LED_MASK = 1UL << LED_PIN;
+
+// Toggles per measurement, 8 per loop iteration to keep the loop overhead small
+constexpr uint32_t TOGGLES = 4096;
+constexpr uint8_t RUNS = 4;
+
+using namespace minisamd21;
+
+struct GpioBenchResults
+{
+    uint32_t frequency;       // Core clock (Hz)
+    uint32_t apb_raw;         // PORT->OUTTGL store
+    uint32_t iobus_raw;       // PORT_IOBUS->OUTTGL store
+    uint32_t pin_toggle;      // Pin::Toggle() (IOBUS, out of line)
+    uint32_t fast_pin_toggle; // FastPin::Toggle()
+    uint32_t done;            // Set when all results are in
+};
+
+volatile GpioBenchResults gpio_bench_results;
+
+#define TOGGLE_8(statement) \
+    statement;              \
+    statement;              \
+    statement;              \
+    statement;              \
+    statement;              \
+    statement;              \
+    statement;              \
+    statement
+
+// Best of RUNS, an interrupt may land in any single run
+template <typename Toggle>
+static uint32_t Measure(Toggle toggle)
+{
+    uint64_t best = UINT64_MAX;
+    for (uint8_t run = 0; run < RUNS; ++run)
+    {
+        uint64_t start = System::GetCycles();
+        for (uint32_t i = 0; i < TOGGLES / 8; ++i)
+        {
+            toggle();
+        }
+        uint64_t cycles = System::GetCycles() - start;
+        if (cycles < best)
+        {
+            best = cycles;
+        }
+    }
+    return static_cast<uint32_t>(static_cast<uint64_t>(TOGGLES) * System::GetFrequency() / best);
+}
+
+int main()
+{
+    System::Init(System::ClockSource::INTERNAL_OSC);
+    System::SetPerformanceLevel(System::PerformanceLevel::HIGH);
+
+    Pin pin(Pin::PortName::PORTA, LED_PIN);
+    FastPin<Pin::PortName::PORTA, LED_PIN> fast_pin;
+    pin.Init(Pin::Mode::OUTPUT);
+
+    gpio_bench_results.frequency = System::GetFrequency();
+    gpio_bench_results.apb_raw = Measure([]
+                                         { TOGGLE_8(PORT->Group[0].OUTTGL.reg = LED_MASK); });
+    gpio_bench_results.iobus_raw = Measure([]
+                                           { TOGGLE_8(PORT_IOBUS->Group[0].OUTTGL.reg = LED_MASK); });
+    gpio_bench_results.pin_toggle = Measure([&pin]
+                                            { TOGGLE_8(pin.Toggle()); });
+    gpio_bench_results.fast_pin_toggle = Measure([&fast_pin]
+                                                 { TOGGLE_8(fast_pin.Toggle()); });
+    gpio_bench_results.done = 1;
+
+    while (1)
+    {
+        // Results are ready
+    }
+}
@@ -0,0 +1,164 @@
+# Print the flash and RAM usage of an ELF per section and per symbol,
+# with the change since the previous report
+#
+#   cmake -DELF=<file> -DSIZE=<size> -DNM=<nm> -DSNAPSHOT=<file> -P SizeReport.cmake
+#
+# The snapshot file is rewritten on every run, so each report shows what the
+# last rebuild changed. Delete it to start over.
+
+foreach(var ELF SIZE NM SNAPSHOT)
+  if(NOT DEFINED ${var})
+    message(FATAL_ERROR "SizeReport: ${var} is not set")
+  endif()
+endforeach()
+
+execute_process(COMMAND ${SIZE} -A ${ELF} OUTPUT_VARIABLE size_output RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "SizeReport: ${SIZE} failed on ${ELF}")
+endif()
+
+execute_process(COMMAND ${NM} -S --size-sort ${ELF} OUTPUT_VARIABLE nm_output RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "SizeReport: ${NM} failed on ${ELF}")
+endif()
+
+# Right-align a value in a column
+function(pad out value width)
+  string(LENGTH "${value}" length)
+  set(padded "${value}")
+  while(length LESS width)
+    set(padded " ${padded}")
+    math(EXPR length "${length} + 1")
+  endwhile()
+  set(${out} "${padded}" PARENT_SCOPE)
+endfunction()
+
+# Signed difference against the snapshot, empty if unchanged
+function(delta out key size)
+  set(text "")
+  if(DEFINED old_${key})
+    math(EXPR diff "${size} - ${old_${key}}")
+    if(diff GREATER 0)
+      set(text "+${diff}")
+    elseif(diff LESS 0)
+      set(text "${diff}")
+    endif()
+  elseif(have_snapshot)
+    set(text "new")
+  endif()
+  set(${out} "${text}" PARENT_SCOPE)
+endfunction()
+
+# Previous run
+set(have_snapshot FALSE)
+set(old_symbols "")
+if(EXISTS ${SNAPSHOT})
+  set(have_snapshot TRUE)
+  file(STRINGS ${SNAPSHOT} snapshot_lines)
+  foreach(line IN LISTS snapshot_lines)
+    if(line MATCHES "^([A-Z]+) ([^ ]+) ([0-9]+)$")
+      set(old_${CMAKE_MATCH_1}_${CMAKE_MATCH_2} ${CMAKE_MATCH_3})
+      if(CMAKE_MATCH_1 STREQUAL "SYM")
+        list(APPEND old_symbols ${CMAKE_MATCH_2})
+      endif()
+    endif()
+  endforeach()
+endif()
+
+set(snapshot "")
+set(flash 0)
+set(ram 0)
+
+get_filename_component(elf_name ${ELF} NAME)
+message("Size report for ${elf_name}")
+message("  Section                 Size    Change")
+
+# Sections with an address are loaded; RAM sections with content (.data) also take flash
+string(REPLACE "\n" ";" size_lines "${size_output}")
+foreach(line IN LISTS size_lines)
+  if(NOT line MATCHES "^(\\.[^ ]+) +([0-9]+) +([0-9]+)")
+    continue()
+  endif()
+  set(name ${CMAKE_MATCH_1})
+  set(size ${CMAKE_MATCH_2})
+  set(address ${CMAKE_MATCH_3})
+  if(address EQUAL 0 OR size EQUAL 0)
+    continue()
+  endif()
+
+  if(address LESS 536870912) # 0x20000000
+    math(EXPR flash "${flash} + ${size}")
+  else()
+    math(EXPR ram "${ram} + ${size}")
+    if(name STREQUAL ".data")
+      math(EXPR flash "${flash} + ${size}")
+    endif()
+  endif()
+
+  delta(change SEC_${name} ${size})
+  pad(size_text ${size} 10)
+  pad(change_text "${change}" 10)
+  string(SUBSTRING "${name}                " 0 16 name_text)
+  message("  ${name_text}${size_text}${change_text}")
+  string(APPEND snapshot "SEC ${name} ${size}\n")
+endforeach()
+
+foreach(region flash ram)
+  string(TOUPPER ${region} key)
+  delta(change TOTAL_${key} ${${region}})
+  pad(size_text ${${region}} 10)
+  pad(change_text "${change}" 10)
+  string(SUBSTRING "${key}                " 0 16 name_text)
+  message("  ${name_text}${size_text}${change_text}")
+  string(APPEND snapshot "TOTAL ${key} ${${region}}\n")
+endforeach()
+
+# Symbols whose size changed, appeared or disappeared
+set(symbol_changes "")
+set(new_symbols "")
+string(REPLACE "\n" ";" nm_lines "${nm_output}")
+foreach(line IN LISTS nm_lines)
+  if(NOT line MATCHES "^([0-9a-fA-F]+) ([0-9a-fA-F]+) ([a-zA-Z]) ([^ ]+)$")
+    continue()
+  endif()
+  set(type ${CMAKE_MATCH_3})
+  set(name ${CMAKE_MATCH_4})
+  math(EXPR size "0x${CMAKE_MATCH_2}")
+
+  # Symbols can repeat (local statics), count them together
+  if(DEFINED new_SYM_${name})
+    math(EXPR size "${size} + ${new_SYM_${name}}")
+  else()
+    list(APPEND new_symbols ${name})
+  endif()
+  set(new_SYM_${name} ${size})
+  set(type_${name} ${type})
+endforeach()
+
+foreach(name IN LISTS new_symbols)
+  delta(change SYM_${name} ${new_SYM_${name}})
+  if(change)
+    pad(change_text "${change}" 10)
+    pad(size_text ${new_SYM_${name}} 8)
+    string(APPEND symbol_changes "  ${change_text}${size_text} ${type_${name}} ${name}\n")
+  endif()
+  string(APPEND snapshot "SYM ${name} ${new_SYM_${name}}\n")
+endforeach()
+
+foreach(name IN LISTS old_symbols)
+  if(NOT DEFINED new_SYM_${name})
+    pad(change_text "-${old_SYM_${name}}" 10)
+    pad(size_text 0 8)
+    string(APPEND symbol_changes "  ${change_text}${size_text}   ${name}\n")
+  endif()
+endforeach()
+
+if(symbol_changes)
+  message("  Symbol changes (change, size, type, name):")
+  string(REGEX REPLACE "\n$" "" symbol_changes "${symbol_changes}")
+  message("${symbol_changes}")
+elseif(have_snapshot)
+  message("  No symbol changes")
+endif()
+
+file(WRITE ${SNAPSHOT} "${snapshot}")
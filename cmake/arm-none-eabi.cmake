@@ -0,0 +1,43 @@
+# Toolchain file for the GNU Arm Embedded toolchain (arm-none-eabi-gcc)
+#
+# The tools are taken from the PATH. To use a specific installation, point
+# ARM_TOOLCHAIN_DIR (CMake or environment variable) to its bin directory:
+#
+#   cmake -B build -DARM_TOOLCHAIN_DIR=/opt/homebrew/bin
+
+set(CMAKE_SYSTEM_NAME Generic)
+set(CMAKE_SYSTEM_PROCESSOR cortex-m0plus)
+
+if(NOT ARM_TOOLCHAIN_DIR AND DEFINED ENV{ARM_TOOLCHAIN_DIR})
+  set(ARM_TOOLCHAIN_DIR $ENV{ARM_TOOLCHAIN_DIR})
+endif()
+
+# Pass the location on to try_compile projects
+list(APPEND CMAKE_TRY_COMPILE_PLATFORM_VARIABLES ARM_TOOLCHAIN_DIR)
+
+if(ARM_TOOLCHAIN_DIR)
+  set(TOOLCHAIN_PREFIX ${ARM_TOOLCHAIN_DIR}/arm-none-eabi-)
+else()
+  set(TOOLCHAIN_PREFIX arm-none-eabi-)
+endif()
+
+set(CMAKE_C_COMPILER ${TOOLCHAIN_PREFIX}gcc)
+set(CMAKE_CXX_COMPILER ${TOOLCHAIN_PREFIX}g++)
+set(CMAKE_ASM_COMPILER ${TOOLCHAIN_PREFIX}gcc)
+
+set(CMAKE_OBJCOPY ${TOOLCHAIN_PREFIX}objcopy)
+set(CMAKE_SIZE ${TOOLCHAIN_PREFIX}size)
+set(CMAKE_NM ${TOOLCHAIN_PREFIX}nm)
+
+# LTO objects need the plugin aware archiver
+set(CMAKE_AR ${TOOLCHAIN_PREFIX}gcc-ar)
+set(CMAKE_RANLIB ${TOOLCHAIN_PREFIX}gcc-ranlib)
+
+# No OS to link test executables against
+set(CMAKE_TRY_COMPILE_TARGET_TYPE STATIC_LIBRARY)
+
+# Never pick up host libraries or headers
+set(CMAKE_FIND_ROOT_PATH_MODE_PROGRAM NEVER)
+set(CMAKE_FIND_ROOT_PATH_MODE_LIBRARY ONLY)
+set(CMAKE_FIND_ROOT_PATH_MODE_INCLUDE ONLY)
+set(CMAKE_FIND_ROOT_PATH_MODE_PACKAGE ONLY)
@@ -1,12 +1,29 @@
 #pragma once
+#include <coroutine>
 #include "Pin.hpp"
 #include "samd21.h"
+#include "minisamd21/Delegate.hpp"
+#include "minisamd21/GenericClock.hpp"
+#include "minisamd21/Dma.hpp"
+#include "minisamd21/EventSystem.hpp"
 
 namespace minisamd21
 {
 
 /**
- * @brief For now it supports blocking mode reading only.
+ * @brief Single-ended ADC input.
+ *
+ * Read() blocks until the conversion is done. ReadAsync() returns right away and
+ * delivers the result to a callback, a pollable Request or a suspended coroutine;
+ * conversions requested by several inputs are queued and run back to back from
+ * the ADC interrupt.
+ *
+ * StartStream() runs the ADC free-running at up to STREAM_RATE samples per second
+ * and lets the DMA fill a ping-pong buffer; the CPU only sees each completed half.
+ * StartSampling() does the same at a fixed rate paced by a timer.
+ *
+ * Init() loads the factory calibration and the offset and gain correction saved
+ * with SaveCalibration(), so the results are corrected in hardware.
  */
 class AdcInput
 {
@@ -56,27 +73,271 @@ public:
     // Read the ADC value
     uint16_t Read() const;
 
-    // Set the reference voltage
-    void SetReference(Reference ref);
+    // Called from the ADC interrupt with the result of an asynchronous read
+    using ReadCallback = Delegate<void(uint16_t result)>;
 
-    // Set the resolution
-    void SetResolution(Resolution res);
+    /**
+     * @brief Pollable handle of an asynchronous read.
+     *
+     * Owned by the caller and linked into the ADC queue while pending, so it must
+     * stay alive until IsDone(). Can be reused once done.
+     */
+    class Request
+    {
+    public:
+        Request() = default;
+        Request(const Request &) = delete;
+        Request &operator=(const Request &) = delete;
+
+        // Queued or converting
+        bool IsPending() const { return state_ == State::PENDING; }
+
+        // The conversion is over, GetResult() holds its value
+        bool IsDone() const { return state_ == State::DONE; }
+
+        uint16_t GetResult() const { return result_; }
+
+    private:
+        friend class AdcInput;
+
+        enum class State : uint8_t
+        {
+            IDLE,
+            PENDING,
+            DONE
+        };
+
+        const AdcInput *adc_ = nullptr;
+        ReadCallback done_; // Called from the interrupt when the result is in
+        Request *next_ = nullptr;
+        volatile uint16_t result_ = 0;
+        volatile State state_ = State::IDLE;
+    };
+
+    /**
+     * @brief Start a conversion and return right away.
+     *
+     * Conversions of all inputs are queued and run back to back from the ADC
+     * interrupt. Poll request.IsDone() or get the result in callback.
+     *
+     * @return false if request is still pending.
+     */
+    bool ReadAsync(Request &request, ReadCallback callback = nullptr) const;
+
+    // Number of reads ReadAsync(callback) can have pending, across all inputs
+    static constexpr uint8_t REQUEST_POOL_SIZE = 4;
+
+    /**
+     * @brief Start a conversion whose result only goes to callback.
+     *
+     * Takes a request from a shared pool of REQUEST_POOL_SIZE.
+     * @return false if all of them are pending.
+     */
+    bool ReadAsync(ReadCallback callback) const;
+
+    // Awaitable returned by ReadAsync(), resumes with the conversion result
+    class ReadAwaiter
+    {
+    public:
+        bool await_ready() const { return false; }
+        void await_suspend(std::coroutine_handle<> handle);
+        uint16_t await_resume() const { return request_.GetResult(); }
+
+    private:
+        friend class AdcInput;
+        ReadAwaiter(const AdcInput &adc) : adc_(adc) {}
+
+        const AdcInput &adc_;
+        Request request_;
+    };
+
+    // Read the ADC value without blocking the core (co_await adc.ReadAsync())
+    ReadAwaiter ReadAsync() const { return ReadAwaiter(*this); }
+
+    // True while asynchronous reads are queued, the ADC stops in standby
+    static bool HasPendingReads() { return pending_head_ != nullptr; }
+
+    // Start a conversion of this input on each event of an Event System channel
+    // (EventSystem::NONE to stop). Don't mix with Read() or ReadAsync() while it runs.
+    void SetStartEvent(uint8_t channel);
+
+    // Get the result of an event started conversion, false if none is ready
+    bool ReadResult(uint16_t &value) const;
+
+    // Called from the DMA interrupt with each filled half of the stream buffer
+    using StreamCallback = Delegate<void(const uint16_t *samples, uint16_t count)>;
+
+    // Stream clock: DFLL48M / 6 = 8MHz, prescaled to a 2MHz ADC clock (2.1MHz max)
+    static constexpr uint32_t STREAM_CLOCK = 8000000;
+
+    // Samples per second of a 12-bit stream, a conversion takes 7 ADC clocks
+    static constexpr uint32_t STREAM_RATE = STREAM_CLOCK / 4 / 7;
+
+    /**
+     * @brief Convert this input continuously into a ping-pong buffer.
+     *
+     * The ADC runs in free-running mode with the shortest sampling time and no averaging;
+     * the DMA moves each result into buffer. When a half is full, callback gets it while
+     * the DMA fills the other half, so it must be done with it within size / 2 samples.
+     * Don't use Read() or ReadAsync() while streaming.
+     *
+     * @param buffer Samples, size entries.
+     * @param size Number of samples, even.
+     * @return false if already streaming, size is odd or no DMA channel or clock generator is free.
+     */
+    bool StartStream(uint16_t *buffer, uint16_t size, StreamCallback callback);
+
+    /**
+     * @brief Convert this input at a fixed rate into a ping-pong buffer.
+     *
+     * Same as StartStream(), but each conversion is started by an overflow event of TC3,
+     * routed to the ADC through the Event System: the sample times depend on the timer
+     * alone, whatever the CPU does. TC3 runs from the core clock (its clock is shared with
+     * TCC2) and is retimed on System::SetPerformanceLevel() changes; it can't drive PWM
+     * outputs meanwhile.
+     *
+     * @param rate Samples per second, up to STREAM_RATE. The actual one is GetSamplingRate().
+     * @return false if the rate is out of range, the stream can't start or no event channel is free.
+     */
+    bool StartSampling(uint32_t rate, uint16_t *buffer, uint16_t size, StreamCallback callback);
+
+    // Actual rate of StartSampling() (the timer divides the core clock), 0 if not sampling
+    // or if the core clock is too slow for the requested rate
+    static uint32_t GetSamplingRate() { return sampling_rate_; }
+
+    // Stop streaming or sampling and restore the single conversion setup
+    void StopStream();
+
+    // Gain correction factor of 1.0
+    static constexpr uint16_t GAIN_ONE = 2048;
+
+    // Offset and gain correction applied by the ADC to each result, without CPU time
+    struct Calibration
+    {
+        int16_t offset; // Subtracted from the conversion (OFFSETCORR, -2048 to 2047)
+        uint16_t gain;  // Then multiplied by gain / GAIN_ONE (GAINCORR, 1024 to 4095)
+    };
 
-    // Set the number of samples to average
-    void SetAveraging(Averaging samples);
+    /**
+     * @brief Two-point calibration from two known input levels.
+     *
+     * Take the raw values after ClearCalibration(), at the resolution in use, for a low
+     * and a high input whose ideal results are expected_low and expected_high.
+     */
+    static Calibration ComputeCalibration(uint16_t raw_low, uint16_t expected_low,
+                                          uint16_t raw_high, uint16_t expected_high);
+
+    // Program the correction registers, all later conversions are corrected
+    static void SetCalibration(const Calibration &calibration);
+
+    // Correction in use, offset 0 and GAIN_ONE when there is none
+    static Calibration GetCalibration();
+
+    // Turn the correction off
+    static void ClearCalibration();
+
+    // Keep the calibration in use in the flash settings row (replacing its content),
+    // Init() applies it again after a reset. The resolution, reference and gain in use
+    // are kept with it.
+    static bool SaveCalibration();
+
+    // Apply the calibration kept in flash, false if there is none or if it was taken
+    // with another resolution, reference or gain
+    static bool LoadCalibration();
+
+    // Set the reference voltage (shared by all inputs)
+    static void SetReference(Reference ref);
+
+    // Set the resolution (shared by all inputs)
+    static void SetResolution(Resolution res);
+
+    // Set the number of samples to average (shared by all inputs)
+    static void SetAveraging(Averaging samples);
+
+    // Called by the ADC_Handler
+    // You should not call this directly
+    static void InterruptHandler();
 
 private:
     Pin pin_;         // Pin object
     uint8_t channel_; // ADC input channel number
 
+    // Asynchronous reads waiting for the ADC, the head one is converting
+    static inline Request *volatile pending_head_ = nullptr;
+    static inline Request *pending_tail_ = nullptr;
+
+    // Stream state, the ADC streams a single input at a time
+    static inline uint16_t *stream_buffer_ = nullptr;
+    static inline uint16_t stream_size_ = 0;
+    static inline StreamCallback stream_callback_ = nullptr;
+    static inline uint8_t stream_dma_ = Dma::NONE;
+    alignas(16) static inline DmacDescriptor stream_descriptor_ = {}; // Second half, the first uses the channel's
+    static inline uint8_t stream_generator_ = GenericClock::NONE;
+    static inline uint16_t saved_ctrlb_ = 0; // Single conversion setup while streaming
+    static inline uint8_t saved_sampctrl_ = 0;
+    static inline uint8_t saved_avgctrl_ = 0;
+    static inline uint8_t sampling_event_ = EventSystem::NONE; // Timer to ADC channel of StartSampling()
+    static inline uint32_t sampling_rate_ = 0;
+    static inline uint32_t sampling_requested_rate_ = 0;
+
+    // TC_CTRLA_PRESCALER_DIV*_Val as shifts
+    static constexpr uint8_t PRESCALER_SHIFTS[] = {0, 1, 2, 3, 4, 6, 8, 10};
+
+    // Prescaler and period of TC3 for a rate, false if out of reach at that frequency
+    static bool ComputeSamplingTimer(uint32_t frequency, uint32_t rate, uint8_t &prescaler, uint32_t &period);
+
+    // Restart TC3 with new settings
+    static void ProgramSamplingTimer(uint32_t frequency, uint8_t prescaler, uint32_t period);
+
+    // Keep the sampling rate after a core clock change
+    static void OnClockChange(void *context, uint32_t frequency);
+
+    friend class AdcScanGroup;
+
     // Map pin to ADC channel
     static uint8_t MapPinToChannel(Pin pin);
 
-    inline void SyncBusy() const
+    // Reset and set up the ADC, left disabled
+    static void InitAdc(Resolution res, Reference ref);
+
+    // Connect a pin to the ADC
+    static void ConfigurePin(Pin pin);
+
+    // Bias and linearity calibration measured in production, from the NVM calibration row
+    static void LoadFactoryCalibration();
+
+    // Calibration as kept in the flash settings row
+    struct StoredCalibration
+    {
+        uint32_t magic;
+        Calibration calibration;
+        uint16_t setup; // CalibrationSetup() when it was saved
+    };
+    static constexpr uint32_t CALIBRATION_MAGIC = 0x32434441; // "ADC2"
+
+    // Resolution, reference and gain in use, a calibration only holds for these
+    static uint16_t CalibrationSetup();
+
+    // Set up the DMA, the clock and the ADC of a stream, the ADC is left disabled
+    bool SetupStream(uint16_t *buffer, uint16_t size, StreamCallback callback);
+
+    // Called by the DMA when a half of the stream buffer is full
+    static void OnStreamBlock();
+
+    // Start a conversion that completes in the interrupt
+    static void StartConversion(uint8_t channel);
+
+    static inline void SyncBusy()
     {
         while (ADC->STATUS.bit.SYNCBUSY)
             ;
     }
+
+    static inline void SyncTC3()
+    {
+        while (TC3->COUNT16.STATUS.bit.SYNCBUSY)
+            ;
+    }
 };
 
 }
@@ -0,0 +1,90 @@
+#pragma once
+#include <cstdint>
+#include <initializer_list>
+#include "minisamd21/AdcInput.hpp"
+#include "minisamd21/Delegate.hpp"
+#include "minisamd21/Dma.hpp"
+
+namespace minisamd21
+{
+
+/**
+ * @brief Several ADC inputs converted in one sweep of the input scan sequencer.
+ *
+ * The ADC scans the channels from the lowest to the highest input of the group
+ * (INPUTSCAN) in free-running mode, so there is no register write or synchronization
+ * between channels, only the conversions. Channels in between that are not in the
+ * group are converted too and dropped. Read() collects the sweep with the CPU,
+ * StartScan() with the DMA in the background.
+ *
+ * Shares the ADC with AdcInput, don't start a scan while other conversions run.
+ *
+ * Usage:
+ *
+ *     AdcScanGroup sensors({Pin(Pin::PortName::PORTA, 2), Pin(Pin::PortName::PORTA, 4), ...});
+ *     sensors.Init();
+ *     uint16_t values[6];
+ *     sensors.Read(values);
+ */
+class AdcScanGroup
+{
+public:
+    static constexpr uint8_t MAX_CHANNELS = 16; // Span of one sweep, from the lowest to the highest input
+
+    // Callback type for the end of a DMA scan, called from the DMA interrupt
+    using Callback = Delegate<void()>;
+
+    // ADC pins whose inputs are at most MAX_CHANNELS apart
+    AdcScanGroup(std::initializer_list<Pin> pins);
+
+    ~AdcScanGroup();
+
+    // Initialize the ADC and the pins, the ADC settings are the ones of AdcInput::Init()
+    void Init(
+        AdcInput::Resolution res = AdcInput::Resolution::BIT12,
+        AdcInput::Reference ref = AdcInput::Reference::INTVCC1);
+
+    // Convert all inputs, values[i] gets the i-th pin given to the constructor
+    void Read(uint16_t *values);
+
+    /**
+     * @brief Convert all inputs in the background.
+     *
+     * The DMA collects the results, get them with GetValues() once done is called
+     * or IsBusy() returns false.
+     *
+     * @return false if a scan is running or no DMA channel is free.
+     */
+    bool StartScan(Callback done = nullptr);
+
+    // A scan started by StartScan() is running
+    bool IsBusy() const { return busy_; }
+
+    // Results of the last StartScan(), in the order of the pins
+    void GetValues(uint16_t *values) const;
+
+    // Number of inputs
+    uint8_t GetCount() const { return count_; }
+
+private:
+    uint8_t count_ = 0;
+    uint8_t pins_[MAX_CHANNELS];          // Pins of the group (port << 5 | pin)
+    uint8_t offsets_[MAX_CHANNELS];       // Position of each pin in the sweep
+    uint8_t first_channel_ = 0;           // Lowest input, where the sweep starts
+    uint8_t span_ = 0;                    // Channels converted per sweep
+    uint8_t dma_channel_ = Dma::NONE;
+    volatile bool busy_ = false;
+    Callback done_;
+    volatile uint16_t results_[MAX_CHANNELS] = {}; // Whole sweep, written by the DMA
+
+    // Start the sequencer on the first channel
+    void BeginSweep();
+
+    // Stop the sequencer and restore single input conversions
+    static void EndSweep();
+
+    // Called by the DMA at the end of the sweep
+    void OnScanDone();
+};
+
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+namespace minisamd21
+{
+
+template <typename Signature, size_t Storage = 2 * sizeof(void *)>
+class Delegate;
+
+/**
+ * @brief Callback carrying its own context, stored inline without heap.
+ *
+ * Holds a plain function, a lambda with captured state, or a member function bound
+ * to an object. The callable is copied into Storage bytes inside the delegate, so it
+ * must be trivially copyable and fit; both are checked at compile time. Calling an
+ * empty delegate does nothing (returns a default value).
+ *
+ * Usage:
+ *
+ *     button.AttachInterrupt(Pin::InterruptMode::FALLING, [&led] { led.Toggle(); });
+ *     System::StartTimer(100, Delegate<void()>::Bind<&Display::Refresh>(display));
+ */
+template <typename R, typename... Args, size_t Storage>
+class Delegate<R(Args...), Storage>
+{
+public:
+    constexpr Delegate() = default;
+    constexpr Delegate(std::nullptr_t) {}
+
+    template <typename F>
+        requires(!std::is_same_v<std::decay_t<F>, Delegate> && std::is_invocable_r_v<R, F &, Args...>)
+    Delegate(F callable)
+    {
+        static_assert(sizeof(F) <= Storage, "Callable too large for the delegate storage");
+        static_assert(alignof(F) <= alignof(void *), "Callable alignment not supported");
+        static_assert(std::is_trivially_copyable_v<F>, "Callable must be trivially copyable");
+
+        ::new (static_cast<void *>(storage_)) F(callable);
+        invoke_ = [](void *storage, Args... args) -> R
+        {
+            return (*static_cast<F *>(storage))(static_cast<Args>(args)...);
+        };
+    }
+
+    // Delegate calling object.*Method
+    template <auto Method, typename T>
+    static Delegate Bind(T &object)
+    {
+        T *pointer = &object;
+        return Delegate([pointer](Args... args) -> R
+                        { return (pointer->*Method)(static_cast<Args>(args)...); });
+    }
+
+    R operator()(Args... args) const
+    {
+        if (invoke_ == nullptr)
+        {
+            if constexpr (!std::is_void_v<R>)
+            {
+                return R{};
+            }
+            else
+            {
+                return;
+            }
+        }
+        return invoke_(storage_, static_cast<Args>(args)...);
+    }
+
+    explicit operator bool() const { return invoke_ != nullptr; }
+
+private:
+    alignas(void *) mutable uint8_t storage_[Storage] = {}; // Mutable lambdas may change their captures
+    R (*invoke_)(void *storage, Args... args) = nullptr;
+};
+
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <cstdint>
+#include "samd21.h"
+#include "minisamd21/Delegate.hpp"
+
+namespace minisamd21
+{
+
+/**
+ * @brief Allocator and helpers for the DMA controller channels.
+ *
+ * Each channel has its first descriptor in the controller's descriptor table;
+ * drivers chain more descriptors of their own (aligned to 16 bytes) through
+ * SetTransfer()'s next argument, back to the first one for a circular transfer.
+ * Triggers are the peripheral DMAC IDs (ADC_DMAC_ID_RESRDY, TC4_DMAC_ID_MC_0, ...).
+ */
+class Dma
+{
+public:
+    // What a trigger starts, as defined by DMAC_CHCTRLB_TRIGACT_*_Val
+    enum class TriggerAction
+    {
+        BLOCK = 0,      // The whole block of the current descriptor
+        BEAT = 2,       // One beat
+        TRANSACTION = 3 // All blocks of the descriptor chain
+    };
+
+    // Size of one beat, as defined by DMAC_BTCTRL_BEATSIZE_*_Val
+    enum class BeatSize
+    {
+        BYTE,
+        HWORD,
+        WORD
+    };
+
+    static constexpr uint8_t NONE = 0xFF; // No channel available
+
+    // Called from the DMAC interrupt when a block flagged with interrupt is done
+    using Callback = Delegate<void()>;
+
+    /**
+     * @brief Get a free channel set up for a trigger.
+     *
+     * @param trigger Peripheral trigger (*_DMAC_ID_*), 0 for software triggers only.
+     * @param action What each trigger transfers.
+     * @param priority Priority level 0 (lowest) to 3.
+     * @return Channel number, or NONE if all channels are taken.
+     */
+    static uint8_t Acquire(uint8_t trigger, TriggerAction action, uint8_t priority = 0);
+
+    // Stop and free a channel
+    static void Release(uint8_t channel);
+
+    // First descriptor of a channel
+    static DmacDescriptor &GetDescriptor(uint8_t channel) { return descriptors_[channel]; }
+
+    /**
+     * @brief Fill a descriptor.
+     *
+     * @param count Number of beats.
+     * @param interrupt Call the channel callback when this block is done.
+     * @param next Descriptor to continue with, nullptr to stop after this one.
+     */
+    static void SetTransfer(DmacDescriptor &descriptor, const volatile void *source, bool source_increment,
+                            volatile void *destination, bool destination_increment, uint16_t count,
+                            BeatSize size, bool interrupt = false, DmacDescriptor *next = nullptr);
+
+    // Start the channel, it transfers on each trigger from its first descriptor
+    static void Enable(uint8_t channel);
+
+    // Stop the channel, waits for a running beat to finish
+    static void Disable(uint8_t channel);
+
+    // Beats left in the block in progress
+    static uint16_t GetRemaining(uint8_t channel) { return writeback_[channel].BTCNT.reg; }
+
+    // Whether descriptor comes after the block in progress (the write-back's DESCADDR)
+    static bool IsNext(uint8_t channel, const DmacDescriptor &descriptor);
+
+    // Set the block done callback of a channel
+    static void SetCallback(uint8_t channel, Callback callback);
+
+    // Called by the DMAC_Handler
+    // You should not call this directly
+    static void InterruptHandler();
+
+private:
+    alignas(16) static inline DmacDescriptor descriptors_[DMAC_CH_NUM] = {};
+    alignas(16) static inline DmacDescriptor writeback_[DMAC_CH_NUM] = {};
+
+    static inline Callback callbacks_[DMAC_CH_NUM] = {};
+    static inline uint16_t used_channels_ = 0;
+    static inline bool initialized_ = false;
+
+    // Enable and reset the controller on first use
+    static void Init();
+};
+
+}
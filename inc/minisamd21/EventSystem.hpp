@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+#include "samd21.h"
+
+namespace minisamd21
+{
+
+/**
+ * @brief Allocator for the Event System channels.
+ *
+ * A channel carries the events of one generator (EVSYS_ID_GEN_*) to any number of
+ * users (EVSYS_ID_USER_*), in hardware: the peripherals react within a few clock
+ * cycles, without an interrupt. The peripheral side still has to enable its event
+ * output and input (Pin::RouteToEvent, AdcInput::SetStartEvent, PwmOutput::SetRetriggerEvent).
+ *
+ * Usage:
+ *
+ *     uint8_t channel = trigger.RouteToEvent(Pin::InterruptMode::RISING);
+ *     adc.SetStartEvent(channel);
+ */
+class EventSystem
+{
+public:
+    // Channel path, as defined by EVSYS_CHANNEL_PATH_*_Val
+    enum class Path
+    {
+        SYNCHRONOUS,    // Clocked by the channel GCLK, same clock domain as the user
+        RESYNCHRONIZED, // Clocked by the channel GCLK, generator in another clock domain
+        ASYNCHRONOUS    // No clock, lowest latency, works in standby
+    };
+
+    // Edge detection of the synchronous and resynchronized paths (EVSYS_CHANNEL_EDGSEL_*_Val)
+    enum class Edge
+    {
+        NONE,
+        RISING,
+        FALLING,
+        BOTH
+    };
+
+    static constexpr uint8_t NONE = 0xFF; // No channel available
+
+    /**
+     * @brief Get a channel and connect it to an event generator.
+     *
+     * @param generator Event generator (EVSYS_ID_GEN_*).
+     * @param path Channel path; the clocked paths use GCLK0.
+     * @param edge Edge detection, ignored on the asynchronous path.
+     * @return Channel number, or NONE if all channels are taken.
+     */
+    static uint8_t Acquire(uint8_t generator, Path path = Path::ASYNCHRONOUS, Edge edge = Edge::NONE);
+
+    // Free a channel, disconnect its users first
+    static void Release(uint8_t channel);
+
+    // Route a channel to an event user (EVSYS_ID_USER_*)
+    static void Connect(uint8_t channel, uint8_t user);
+
+    // Detach an event user from its channel
+    static void Disconnect(uint8_t user);
+
+private:
+    static inline uint16_t used_channels_ = 0;
+
+    // Enable the EVSYS bus clock on first use
+    static void Init();
+};
+
+}
@@ -0,0 +1,243 @@
+#pragma once
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace minisamd21
+{
+
+template <typename T>
+class Task;
+
+/**
+ * @brief Cooperative scheduler for stackless coroutines.
+ *
+ * Drivers complete awaitables (System::Sleep, AdcInput::ReadAsync, I2C::TransferAsync)
+ * from their interrupts by putting the waiting coroutine on a single ready queue;
+ * Run() resumes it from the main loop. Coroutine frames come from a static arena,
+ * there is no heap.
+ *
+ * Usage:
+ *
+ *     Task<> Blink(Pin &led)
+ *     {
+ *         while (1)
+ *         {
+ *             led.Toggle();
+ *             co_await System::Sleep(500);
+ *         }
+ *     }
+ *
+ *     Executor::Spawn(Blink(led));
+ *     while (1)
+ *     {
+ *         Executor::Run();
+ *     }
+ */
+class Executor
+{
+public:
+    // Memory for all coroutine frames
+    static constexpr size_t ARENA_SIZE = 4096;
+
+    // Coroutines that can be ready at the same time (power of two)
+    static constexpr uint8_t MAX_READY = 32;
+
+    // Start a task detached, its frame is freed when it finishes
+    // Returns false if the frame could not be allocated
+    template <typename T>
+    static bool Spawn(Task<T> &&task);
+
+    // Make a suspended coroutine ready, safe to call from interrupts
+    static void Schedule(std::coroutine_handle<> handle);
+
+    // Process software timers and deferred pin interrupts, then resume the coroutines that are ready
+    // Call this from the main loop
+    static void Run();
+
+    // True if no coroutine is ready, no pin event is queued and no ADC read or I2C transfer
+    // is in flight, the main loop may go to sleep
+    static bool IsIdle();
+
+    // Frame allocation, not to be used from interrupts
+    static void *Allocate(size_t size);
+    static void Free(void *pointer);
+
+private:
+    // Arena block header, the size includes the header
+    struct Block
+    {
+        uint32_t size;
+        Block *next; // Next free block, by address
+    };
+    static constexpr size_t BLOCK_ALIGN = 8;
+
+    alignas(BLOCK_ALIGN) static inline uint8_t arena_[ARENA_SIZE] = {};
+    static inline Block *free_list_ = nullptr;
+    static inline bool arena_initialized_ = false;
+
+    static inline void *ready_[MAX_READY] = {};
+    static inline volatile uint8_t ready_head_ = 0;
+    static inline volatile uint8_t ready_count_ = 0;
+};
+
+// Promise parts shared by all task types
+class TaskPromiseBase
+{
+public:
+    static void *operator new(size_t size) noexcept { return Executor::Allocate(size); }
+    static void operator delete(void *pointer) noexcept { Executor::Free(pointer); }
+
+    // Tasks start when awaited or spawned
+    std::suspend_always initial_suspend() noexcept { return {}; }
+
+    // Continue with the awaiting coroutine, or free a detached task
+    struct FinalAwaiter
+    {
+        bool await_ready() noexcept { return false; }
+
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+        {
+            TaskPromiseBase &promise = handle.promise();
+            if (promise.continuation_)
+            {
+                return promise.continuation_;
+            }
+            if (promise.detached_)
+            {
+                handle.destroy();
+            }
+            return std::noop_coroutine();
+        }
+
+        void await_resume() noexcept {}
+    };
+
+    FinalAwaiter final_suspend() noexcept { return {}; }
+
+    void unhandled_exception()
+    {
+        while (1)
+        {
+            // fail, exceptions are disabled
+        }
+    }
+
+    std::coroutine_handle<> continuation_;
+    bool detached_ = false;
+};
+
+// Storage of the task result
+template <typename T>
+class TaskResult
+{
+public:
+    void return_value(T value) noexcept { value_ = value; }
+    T value_{};
+};
+
+template <>
+class TaskResult<void>
+{
+public:
+    void return_void() noexcept {}
+};
+
+/**
+ * @brief Coroutine returned by asynchronous workflows.
+ *
+ * Starts when it is awaited (co_await task) or passed to Executor::Spawn().
+ * If the arena is full the task is empty; awaiting it returns a default value
+ * and Spawn() returns false.
+ */
+template <typename T = void>
+class [[nodiscard]] Task
+{
+public:
+    class promise_type : public TaskPromiseBase, public TaskResult<T>
+    {
+    public:
+        Task get_return_object() noexcept { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        static Task get_return_object_on_allocation_failure() noexcept { return Task(); }
+    };
+
+    Task() = default;
+    Task(Task &&other) noexcept : handle_(other.handle_) { other.handle_ = nullptr; }
+    Task &operator=(Task &&other) noexcept
+    {
+        if (this != &other)
+        {
+            if (handle_)
+            {
+                handle_.destroy();
+            }
+            handle_ = other.handle_;
+            other.handle_ = nullptr;
+        }
+        return *this;
+    }
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+
+    ~Task()
+    {
+        if (handle_)
+        {
+            handle_.destroy();
+        }
+    }
+
+    // False if the frame could not be allocated
+    bool IsValid() const { return static_cast<bool>(handle_); }
+
+    auto operator co_await() && noexcept
+    {
+        struct Awaiter
+        {
+            std::coroutine_handle<promise_type> handle;
+
+            bool await_ready() noexcept { return !handle || handle.done(); }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+            {
+                handle.promise().continuation_ = awaiting;
+                return handle;
+            }
+
+            T await_resume() noexcept
+            {
+                if constexpr (!std::is_void_v<T>)
+                {
+                    return handle ? handle.promise().value_ : T{};
+                }
+            }
+        };
+        return Awaiter{handle_};
+    }
+
+private:
+    friend class Executor;
+
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+
+    std::coroutine_handle<promise_type> handle_;
+};
+
+template <typename T>
+bool Executor::Spawn(Task<T> &&task)
+{
+    auto handle = task.handle_;
+    if (!handle)
+    {
+        return false;
+    }
+    task.handle_ = nullptr;
+
+    handle.promise().detached_ = true;
+    Schedule(handle);
+    return true;
+}
+
+}
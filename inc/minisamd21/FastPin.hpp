@@ -0,0 +1,80 @@
+#pragma once
+#include "minisamd21/Pin.hpp"
+#include "samd21.h"
+
+#define MINISAMD21_ALWAYS_INLINE inline __attribute__((always_inline))
+
+namespace minisamd21
+{
+
+/**
+ * @brief GPIO pin fixed at compile time.
+ *
+ * Same interface as Pin, but the port and pin are template parameters, so the
+ * register address and mask are constants and Write/Toggle/Read are inlined to a
+ * single IOBUS load or store, even at -O0. Read relies on the continuous sampling
+ * that Init() enables for inputs (not with Pin::SAMPLE_ON_DEMAND). Drivers templated on the pin type
+ * (OutShiftRegister) accept both; it converts to a Pin where a runtime pin is needed
+ * (interrupts, ADC, PWM).
+ *
+ * Usage:
+ *
+ *     FastPin<Pin::PortName::PORTA, 17> data;
+ *     data.Init(Pin::Mode::OUTPUT);
+ *     data.Write(true);
+ */
+template <Pin::PortName P, uint8_t N>
+class FastPin
+{
+    static_assert(N < 32, "A port has 32 pins");
+
+public:
+    static constexpr Pin::PortName PORT_NAME = P;
+    static constexpr uint8_t PIN = N;
+    static constexpr uint32_t MASK = 1UL << N;
+
+    // Initialize the pin, rarely time critical
+    void Init(Pin::Mode mode, uint8_t options = 0) { Pin(P, N).Init(mode, options); }
+
+    void DeInit() { Pin(P, N).DeInit(); }
+
+    // Read the pin (returns true for HIGH, false for LOW)
+    MINISAMD21_ALWAYS_INLINE bool Read() const
+    {
+        return (Group()->IN.reg & MASK) != 0;
+    }
+
+    // Set the pin HIGH or LOW
+    MINISAMD21_ALWAYS_INLINE void Write(bool value)
+    {
+        if (value)
+        {
+            Group()->OUTSET.reg = MASK;
+        }
+        else
+        {
+            Group()->OUTCLR.reg = MASK;
+        }
+    }
+
+    // Toggle the pin
+    MINISAMD21_ALWAYS_INLINE void Toggle()
+    {
+        Group()->OUTTGL.reg = MASK;
+    }
+
+    constexpr uint8_t GetPin() const { return N; }
+
+    constexpr Pin::PortName GetPort() const { return P; }
+
+    // Runtime pin for the APIs taking a Pin
+    operator Pin() const { return Pin(P, N); }
+
+private:
+    static MINISAMD21_ALWAYS_INLINE PortGroup *Group()
+    {
+        return &PORT_IOBUS->Group[static_cast<uint8_t>(P)];
+    }
+};
+
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+#include "samd21.h"
+
+namespace minisamd21
+{
+
+/**
+ * @brief Erase and write the internal flash.
+ *
+ * Flash is erased by rows (ROW_SIZE) to all ones and written by pages (PAGE_SIZE).
+ * The linker script keeps the last row out of the program, GetSettings() and
+ * WriteSettings() use it to keep data across resets and reflashing of the program.
+ * The CPU stalls on flash accesses while a row is erased or a page written.
+ */
+class Flash
+{
+public:
+    static constexpr uint32_t PAGE_SIZE = NVMCTRL_PAGE_SIZE;
+    static constexpr uint32_t ROW_SIZE = NVMCTRL_ROW_SIZE;
+
+    // Erase the row at address (row aligned)
+    static bool EraseRow(uint32_t address);
+
+    /**
+     * @brief Write to erased flash.
+     *
+     * @param address Page aligned.
+     * @param size Bytes, rounded up to whole words.
+     * @return false if the address is not aligned or the write failed (locked region).
+     */
+    static bool Write(uint32_t address, const void *data, uint32_t size);
+
+    // Content of the settings row, all 0xFF when nothing was written
+    static const void *GetSettings();
+
+    // Replace the settings row with size bytes of data (up to ROW_SIZE)
+    static bool WriteSettings(const void *data, uint32_t size);
+
+private:
+    // Run a command on the row or page at address, wait for it to finish
+    static bool Command(uint32_t command, uint32_t address);
+};
+
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <cstdint>
+#include "samd21.h"
+
+namespace minisamd21
+{
+
+/**
+ * @brief Allocator for the generic clock generators and peripheral clock channels.
+ *
+ * Generators 1-8 are handed out by source, divider and standby behaviour. A request matching
+ * a generator that is already running shares it and only bumps its reference count; the
+ * generator is disabled again when the last user releases it.
+ *
+ * Generator 0 is the core clock and is owned by System. Peripherals clocked from it only
+ * need Connect() with MAIN.
+ *
+ * Channel routing is cached, so connecting a peripheral to the generator it already uses
+ * costs no register write and no synchronization wait.
+ */
+class GenericClock
+{
+public:
+    // Clock sources, as defined by GCLK_GENCTRL_SRC_*_Val
+    enum class Source
+    {
+        XOSC,
+        GCLKIN,
+        GCLKGEN1,
+        OSCULP32K,
+        OSC32K,
+        XOSC32K,
+        OSC8M,
+        DFLL48M,
+        FDPLL96M
+    };
+
+    static constexpr uint8_t MAIN = 0;    // GCLK0, core clock
+    static constexpr uint8_t NONE = 0xFF; // No generator available
+
+    /**
+     * @brief Get a generator running from the given source and divider.
+     *
+     * @param source Clock source of the generator.
+     * @param divider Division factor (up to 255, generator 1 allows up to 65535).
+     * @param run_standby Keep the generator running in standby sleep.
+     * @return Generator number, or NONE if all suitable generators are taken.
+     */
+    static uint8_t Acquire(Source source, uint32_t divider = 1, bool run_standby = false);
+
+    // Drop a reference, the generator is disabled when nobody uses it anymore
+    static void Release(uint8_t generator);
+
+    // Route a generator to a peripheral channel (GCLK_CLKCTRL_ID_*_Val)
+    static void Connect(uint8_t channel, uint8_t generator);
+
+    // Stop the clock of a peripheral channel
+    static void Disconnect(uint8_t channel);
+
+private:
+    struct Generator
+    {
+        Source source;
+        uint16_t divider;
+        bool run_standby;
+        uint8_t references;
+    };
+
+    static inline Generator generators_[GCLK_GEN_NUM] = {};
+
+    // Generator routed to each channel plus one (0 = unknown or disabled)
+    static inline uint8_t channels_[GCLK_NUM] = {0};
+
+    // Largest divider supported by a generator
+    static uint32_t MaxDivider(uint8_t generator);
+
+    static inline void SyncBusy()
+    {
+        while (GCLK->STATUS.bit.SYNCBUSY)
+            ;
+    }
+};
+
+}
@@ -1,6 +1,8 @@
 #pragma once
+#include <coroutine>
 #include <cstdint>
 #include "samd21.h"
+#include "minisamd21/Delegate.hpp"
 
 namespace minisamd21
 {
@@ -18,6 +20,7 @@ public:
     static constexpr uint32_t SPEED_400KHZ = 400000;
 
     I2C(Interface iface);
+    ~I2C();
     void Init(uint32_t baud);
     void DeInit();
     void Write(uint8_t address, uint8_t *data, uint32_t length, bool nostop = false);
@@ -26,11 +29,72 @@ public:
     void WriteRegisters(uint16_t address, uint16_t register_address, uint8_t register_address_size, uint8_t *data, uint32_t length);
     void ReadRegisters(uint16_t address, uint16_t register_address, uint8_t register_address_size, uint8_t *data, uint32_t length);
 
+    // Awaitable returned by TransferAsync(), resumes with false on NACK or bus error
+    class TransferAwaiter
+    {
+    public:
+        bool await_ready() const { return false; }
+        void await_suspend(std::coroutine_handle<> handle);
+        bool await_resume() const { return result_; }
+
+    private:
+        friend class I2C;
+        TransferAwaiter(I2C &i2c, uint8_t address, const uint8_t *write_data, uint32_t write_length, uint8_t *read_data, uint32_t read_length)
+            : i2c_(i2c), address_(address), write_data_(write_data), write_length_(write_length), read_data_(read_data), read_length_(read_length)
+        {
+        }
+
+        I2C &i2c_;
+        uint8_t address_;
+        const uint8_t *write_data_;
+        uint32_t write_length_;
+        uint8_t *read_data_;
+        uint32_t read_length_;
+        Delegate<void()> done_; // Called from the interrupt when the result is in
+        TransferAwaiter *next_ = nullptr;
+        bool result_ = false;
+    };
+
+    // Write and/or read (with a repeated start in between) without blocking the core
+    // Transfers of several coroutines are queued and run from the SERCOM interrupt
+    TransferAwaiter TransferAsync(uint8_t address, const uint8_t *write_data, uint32_t write_length, uint8_t *read_data = nullptr, uint32_t read_length = 0)
+    {
+        return TransferAwaiter(*this, address, write_data, write_length, read_data, read_length);
+    }
+
+    // True while asynchronous transfers are queued on any instance, the SERCOM stops in standby
+    static bool HasPendingTransfers();
+
+    // Called by the SERCOMx_Handler
+    // You should not call this directly
+    static void InterruptHandler(uint8_t index);
+
 private:
     Sercom *sercom_;
+    uint8_t index_ = 0;
     uint32_t baud_ = 0;
 
+    // Instances with asynchronous transfers, by SERCOM number
+    static inline I2C *instances_[2] = {nullptr, nullptr};
+
+    // Asynchronous transfers waiting for the bus, the head one is running
+    TransferAwaiter *volatile transfer_head_ = nullptr;
+    TransferAwaiter *transfer_tail_ = nullptr;
+    uint32_t transfer_index_ = 0;
+    bool transfer_reading_ = false;
+
+    // Transfer state machine
+    void StartTransfer(TransferAwaiter &transfer);
+    void FinishTransfer(bool result);
+    void HandleInterrupt();
+    void SendCommand(uint32_t command, bool nack = false);
+
     void EnablePeripheral();
+    void SetBaud(uint32_t frequency);
+    void Enable();
+
+    // Recompute BAUD after a core clock change
+    static void OnClockChange(void *context, uint32_t frequency);
     void FillAddress(uint16_t register_address, uint8_t address_size, uint8_t *data);
 };
 
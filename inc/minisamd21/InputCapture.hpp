@@ -0,0 +1,100 @@
+#pragma once
+#include <cstdint>
+#include "Pin.hpp"
+#include "minisamd21/Dma.hpp"
+#include "minisamd21/EventSystem.hpp"
+#include "minisamd21/GenericClock.hpp"
+#include "samd21.h"
+
+namespace minisamd21
+{
+
+/**
+ * @brief Period and pulse width measurement on an EIC-capable pin.
+ *
+ * The pin level goes through the EIC and an Event System channel into TC4, which
+ * runs with TC5 as one 32-bit counter from the DFLL (48MHz) in period and pulse-width capture
+ * (PPW) mode: each rising edge captures the period and restarts the counter, each
+ * falling edge captures the high time. A DMA channel copies both captures into a
+ * ring of the last N samples, so there is no CPU work per edge; Read() averages them.
+ *
+ * Uses TC4 and TC5: Init() fails while a PwmOutput runs on either, and PwmOutput::Init()
+ * on them fails while measuring. One instance at a time.
+ *
+ * Usage:
+ *
+ *     InputCapture capture(Pin(Pin::PortName::PORTA, 18));
+ *     capture.Init(8);
+ *     float hz = capture.GetFrequency();
+ */
+class InputCapture
+{
+public:
+    static constexpr uint8_t MAX_AVERAGE = 16; // Samples kept for averaging
+
+    InputCapture(Pin pin) : pin_(pin) {}
+
+    ~InputCapture() { DeInit(); }
+
+    /**
+     * @brief Start measuring.
+     *
+     * @param average Number of periods to average (1 to MAX_AVERAGE).
+     * @return false if the pin has no EXTINT line or TC4/TC5 (also by a PwmOutput), an event
+     * or DMA channel or a clock generator are taken.
+     */
+    bool Init(uint8_t average = 1);
+
+    // Stop measuring and free the timer and channels
+    void DeInit();
+
+    /**
+     * @brief Get the averaged period and high time in counter ticks (1/System::GetDfllFrequency()).
+     *
+     * @return false until average periods were measured, or if the signal stopped
+     * (no edge for twice the period).
+     */
+    bool Read(uint32_t &period, uint32_t &pulse_width) const;
+
+    // Frequency in Hz, 0 if there is no signal
+    float GetFrequency() const;
+
+    // Duty cycle (0.0-1.0), 0 if there is no signal
+    float GetDutyCycle() const;
+
+    // True while an instance measures, TC4/TC5 are taken then
+    static bool IsInUse() { return in_use_; }
+
+private:
+    // Captures copied by the DMA on each period, CC0 then CC1
+    struct Sample
+    {
+        uint32_t period;
+        uint32_t pulse_width;
+    };
+
+    Pin pin_;
+    uint8_t average_ = 0;
+    uint8_t event_channel_ = EventSystem::NONE;
+    uint8_t dma_channel_ = Dma::NONE;
+    uint8_t generator_ = GenericClock::NONE;
+
+    volatile Sample samples_[MAX_AVERAGE] = {};
+    volatile Sample discarded_ = {}; // First capture, from the counter start to the first edge
+
+    // Descriptors of the samples ring, the channel's own one takes the first capture
+    alignas(16) DmacDescriptor descriptors_[MAX_AVERAGE] = {};
+
+    static inline bool in_use_ = false; // TC4/TC5 taken by an instance
+
+    // Read the counter value
+    static uint32_t GetCount();
+
+    static inline void SyncTC()
+    {
+        while (TC4->COUNT32.STATUS.bit.SYNCBUSY)
+            ;
+    }
+};
+
+}
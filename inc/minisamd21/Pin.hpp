@@ -1,5 +1,7 @@
 #pragma once
 #include "samd21.h"
+#include "minisamd21/Delegate.hpp"
+#include "minisamd21/SpscRing.hpp"
 
 namespace minisamd21
 {
@@ -9,13 +11,16 @@ namespace minisamd21
  *
  * This class provides methods to initialize, read, and write to GPIO pins on the SAMD21 microcontroller.
  * It supports setting the pin mode as INPUT, INPUT_PULLUP, or OUTPUT, and reading or writing the pin state.
+ * Reads, writes and toggles use the single-cycle IOBUS; inputs are sampled continuously for that,
+ * unless SAMPLE_ON_DEMAND trades the read latency for power. ConfigureGroup() sets up many
+ * pins of a port at once.
  *
  */
 class Pin
 {
 public:
-    // Callback type for interrupt handlers
-    using Callback = void (*)();
+    // Callback type for interrupt handlers, may capture state (a driver, a pin)
+    using Callback = Delegate<void()>;
 
     enum class PortName
     {
@@ -28,21 +33,36 @@ public:
     {
         INPUT,
         INPUT_PULLUP,
+        INPUT_PULLDOWN,
         OUTPUT
     };
 
+    // Init options, combine with |
+    static constexpr uint8_t DRIVE_STRONG = 1 << 0;     // Stronger output driver (PINCFG.DRVSTR), faster edges on long traces
+    static constexpr uint8_t SAMPLE_ON_DEMAND = 1 << 1; // Sample inputs only when read: saves power, reads take 2 more cycles over the APB
+
     enum class InterruptMode
     {
         FALLING,
         RISING,
-        CHANGE
+        CHANGE,
+        HIGH, // Level, for event routing (the interrupt repeats while the level lasts)
+        LOW
     };
 
     // Constructor
     Pin(PortName port, uint8_t pin) : port_(port), pin_(pin) {}
 
-    // Initialize the pin
-    void Init(Mode mode);
+    // Initialize the pin, options are DRIVE_STRONG and SAMPLE_ON_DEMAND
+    void Init(Mode mode, uint8_t options = 0);
+
+    /**
+     * @brief Initialize several pins of a port at once.
+     *
+     * Same as Init() on each pin of mask, but the pin configuration takes a single
+     * WRCONFIG write per half port instead of one PINCFG access per pin.
+     */
+    static void ConfigureGroup(PortName port, uint32_t mask, Mode mode, uint8_t options = 0);
 
     void DeInit();
 
@@ -61,23 +81,130 @@ public:
     // Get the port name
     PortName GetPort() const;
 
+    // Number of external interrupt lines of the EIC
+    static constexpr uint8_t EXTINT_LINES = 16;
+
+    // No external interrupt line (PA08 is the NMI, some pins have none)
+    static constexpr uint8_t EXTINT_NONE = 0xFF;
+
+    // External interrupt line of a pin, pins of both ports share the 16 lines
+    static constexpr uint8_t GetExtInt(PortName port, uint8_t pin)
+    {
+        if (pin >= 32 || static_cast<uint8_t>(port) >= PORT_GROUPS)
+        {
+            return EXTINT_NONE;
+        }
+        return EXTINT_TABLE[static_cast<uint8_t>(port)][pin];
+    }
+
     // Attach an interrupt to the pin
-    void AttachInterrupt(Pin::InterruptMode mode, Callback callback, bool wakeup = false);
+    // Returns false if the pin has no interrupt line. A pin on the same line as an
+    // already attached one (PA04 and PA20 for instance) replaces it.
+    bool AttachInterrupt(Pin::InterruptMode mode, Callback callback, bool wakeup = false);
+
+    // Edge recorded by a deferred interrupt
+    struct Event
+    {
+        uint32_t ticks; // Timebase ticks when the interrupt ran (lower 32 bits of System::GetTicks())
+        uint8_t line;   // EXTINT line
+        bool level;     // Pin level read in the interrupt
+    };
+
+    // Callback type for deferred interrupts
+    using EventCallback = Delegate<void(const Event &)>;
+
+    // Edges that can wait for ProcessEvents() (power of two)
+    static constexpr uint8_t EVENT_QUEUE_SIZE = 32;
+
+    // Attach an interrupt that only queues the edge, the callback runs from ProcessEvents()
+    // For handlers that take time: they no longer hold off the other interrupts
+    bool AttachDeferredInterrupt(Pin::InterruptMode mode, EventCallback callback, bool wakeup = false);
+
+    // Default lockout of debounced interrupts
+    static constexpr uint16_t DEBOUNCE_MS = 20;
+
+    /**
+     * @brief Attach a deferred interrupt that reports each press of a bouncing input once.
+     *
+     * Each edge is queued like a deferred interrupt; ProcessEvents() (re)starts a software
+     * timer of lockout_ms on it. When the line stayed quiet that long, the pin is read and
+     * the callback runs if the level changed since the last report and matches mode. So a
+     * press is reported once, however it bounces, lockout_ms after its last bounce. Needs
+     * the software timers running (System::ProcessTimers()). The EIC filter only removes
+     * glitches of a few EIC clock periods, not contact bounce.
+     */
+    bool AttachDebouncedInterrupt(Pin::InterruptMode mode, EventCallback callback, uint16_t lockout_ms = DEBOUNCE_MS, bool wakeup = false);
+
+    /**
+     * @brief Send the edges of this pin to an Event System channel instead of the CPU.
+     *
+     * Connect the channel to peripheral users (EventSystem::Connect, AdcInput::SetStartEvent,
+     * PwmOutput::SetRetriggerEvent); they react in hardware within a few clock cycles.
+     *
+     * @return Event channel, or EventSystem::NONE if the pin has no line or no channel is free.
+     */
+    uint8_t RouteToEvent(Pin::InterruptMode mode);
+
+    // Stop the event output of this pin and free the channel returned by RouteToEvent()
+    void UnrouteEvent(uint8_t channel);
+
+    // Run the callbacks of the queued edges, call this from the main loop (Executor::Run() does)
+    static void ProcessEvents();
+
+    // True if edges are waiting for ProcessEvents()
+    static bool HasEvents();
+
+    // Edges dropped because the queue was full, raise EVENT_QUEUE_SIZE if this is not 0
+    static uint32_t GetEventOverflows();
 
     // Called by the EIC_Handler
     // You should not call this directly
-    static void InterruptHandler(uint8_t pinNumber);
+    static void InterruptHandler(uint8_t line);
 
 private:
     PortName port_;
     uint8_t pin_;
 
-    // Enable interrupt
-    void EnableInterrupt(InterruptMode mode);
-
-    static inline Callback interrupt_callbacks_[32] = {nullptr};
-    static inline bool interrupt_attached_[32] = {false};
+    // Pin to EXTINT line (I/O multiplexing table, function A)
+    static constexpr uint8_t EXTINT_TABLE[2][32] = {
+        // PA00-PA31
+        {0, 1, 2, 3, 4, 5, 6, 7, EXTINT_NONE, 9, 10, 11, 12, 13, 14, 15,
+         0, 1, 2, 3, 4, 5, 6, 7, 12, 13, EXTINT_NONE, 15, 8, EXTINT_NONE, 10, 11},
+        // PB00-PB31
+        {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+         0, 1, EXTINT_NONE, EXTINT_NONE, EXTINT_NONE, EXTINT_NONE, 6, 7,
+         EXTINT_NONE, EXTINT_NONE, EXTINT_NONE, EXTINT_NONE, EXTINT_NONE, EXTINT_NONE, 14, 15}};
+
+    // Connect the pin to its line and set the sense mode
+    void ConfigureLine(InterruptMode mode, uint8_t line, bool filter);
+
+    // Enable interrupt on the given line
+    void EnableInterrupt(InterruptMode mode, uint8_t line, bool wakeup, bool filter = false);
+
+    // Restart the quiet wait of a debounced line on an edge
+    static void RestartDebounce(const Event &event);
+
+    // The line of a debounced interrupt stayed quiet, report a level change
+    static void DebounceExpired(uint8_t line);
+
+    // Sample the inputs of mask every cycle instead of on demand, required to read them over the IOBUS
+    static void SetContinuousSampling(uint8_t group, uint32_t mask, bool enable);
+
+    static inline Callback interrupt_callbacks_[EXTINT_LINES] = {}; // By EXTINT line
+    static inline EventCallback event_callbacks_[EXTINT_LINES] = {};
+    static inline uint8_t line_pins_[EXTINT_LINES] = {}; // Attached pin (port << 5 | pin)
+    static inline volatile uint16_t deferred_lines_ = 0;
+    static inline volatile uint16_t debounced_lines_ = 0;
+    static inline InterruptMode debounce_modes_[EXTINT_LINES] = {};
+    static inline uint16_t lockout_ms_[EXTINT_LINES] = {};
+    static inline uint32_t last_edge_ticks_[EXTINT_LINES] = {};
+    static inline uint16_t debounce_timers_[EXTINT_LINES] = {}; // System::TimerId of the quiet wait
+    static inline uint16_t debounce_levels_ = 0;                 // Last reported level of each line
+    static inline SpscRing<Event, EVENT_QUEUE_SIZE> events_;
+    static inline volatile uint32_t event_overflows_ = 0;
     static inline bool eic_initialized_ = false;
+    static inline uint32_t sampling_mask_[2] = {0, 0}; // Pins with continuous sampling (PORT CTRL copy)
+    static inline uint8_t eic_wakeup_gclk_ = 0xFF; // GenericClock::NONE until a wakeup pin is attached
 
     // Initialize the External Interrupt Controller
     static void InitEIC();
@@ -0,0 +1,68 @@
+#pragma once
+#include <cstdint>
+#include <initializer_list>
+#include "minisamd21/Pin.hpp"
+
+namespace minisamd21
+{
+
+/**
+ * @brief Up to 16 pins of one port driven and read as a single value.
+ *
+ * Bit i of the bus value is the i-th pin given to the constructor. Masks and the
+ * bit scatter tables are computed once, so Write() changes all pins with a single
+ * store of OUT (no skew between pins) and Read() takes one load of IN.
+ *
+ * Usage:
+ *
+ *     PortBus data({Pin(Pin::PortName::PORTA, 8), Pin(Pin::PortName::PORTA, 9), ...});
+ *     data.Init(Pin::Mode::OUTPUT);
+ *     data.Write(0xA5);
+ */
+class PortBus
+{
+public:
+    static constexpr uint8_t MAX_PINS = 16;
+
+    // All pins must be on the same port, at most MAX_PINS
+    PortBus(std::initializer_list<Pin> pins);
+
+    // Initialize all pins at once (Pin::DRIVE_STRONG is the only option)
+    void Init(Pin::Mode mode, uint8_t options = 0);
+
+    void DeInit();
+
+    // Set all pins at once from the bits of value
+    void Write(uint16_t value);
+
+    // Read all pins at once
+    uint16_t Read() const;
+
+    // Number of pins
+    uint8_t GetWidth() const { return count_; }
+
+    // Port bits covered by the bus
+    uint32_t GetMask() const { return mask_; }
+
+private:
+    static constexpr uint8_t NOT_CONTIGUOUS = 0xFF;
+
+    Pin::PortName port_;
+    uint8_t pins_[MAX_PINS];
+    uint8_t count_ = 0;
+    uint32_t mask_ = 0;
+
+    // Pins in ascending order without gaps, the value only needs a shift
+    uint8_t shift_ = NOT_CONTIGUOUS;
+
+    // Port bits for each nibble of the value, otherwise
+    uint32_t scatter_[MAX_PINS / 4][16] = {};
+
+    // Port bits of a bus value
+    uint32_t Scatter(uint16_t value) const;
+
+    // Port of the first pin, PORTA for an empty list (rejected by the constructor)
+    static Pin::PortName FirstPort(std::initializer_list<Pin> pins);
+};
+
+}
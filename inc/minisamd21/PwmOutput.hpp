@@ -15,6 +15,9 @@ namespace minisamd21
  *
  * The implementation automatically maps pins to their appropriate timer peripheral
  * based on the hardware capabilities of the SAMD21 chip.
+ *
+ * TC4 and TC5 are shared with InputCapture: Init() on a pin of them fails while an
+ * InputCapture measures, and InputCapture::Init() fails once a PWM output runs on them.
  */
 class PwmOutput
 {
@@ -48,9 +51,13 @@ public:
     {
     }
 
+    ~PwmOutput();
+
     /**
      * Initialize the PWM output with the specified frequency
      * @param frequency PWM frequency in Hz (up to 24MHz)
+     * The period is kept to 2 to 65536 core clocks (2^24 on TCC0 and TCC1), a frequency
+     * out of that range at the current performance level runs at the nearest one
      */
     void Init(uint32_t frequency = DEFAULT_FREQUENCY);
 
@@ -60,12 +67,25 @@ public:
      */
     void Write(float duty_cycle);
 
+    /**
+     * Restart the PWM period on each event of an Event System channel (EventSystem::NONE to stop)
+     * The timer is shared by the outputs on it, they all restart
+     * @return false if the output is not initialized
+     */
+    bool SetRetriggerEvent(uint8_t channel);
+
     // Default frequency is 1kHz
     static constexpr uint32_t DEFAULT_FREQUENCY = 1000;
 
     // Maximum frequency depends on system clock
     static constexpr uint32_t MAX_FREQUENCY = System::FREQUENCY / 1000;
 
+    // Shortest period in timer clocks, one low and one high count
+    static constexpr uint32_t MIN_PERIOD = 2;
+
+    // True if PWM outputs run on a timer (0-2 for TCC0-TCC2, 3-5 for TC3-TC5)
+    static bool IsTimerEnabled(uint8_t timer_num) { return timer_enabled_[timer_num]; }
+
 private:
     Pin pin_;            // Pin object
     uint32_t frequency_; // PWM frequency in Hz
@@ -75,17 +95,26 @@ private:
     uint8_t timer_channel_; // TC or TCC channel number
     TimerType timer_type_;  // Type of timer (TC or TCC)
     void *timer_instance_;  // Pointer to TC or TCC instance
+    uint8_t timer_num_ = 0;   // Index into the timer tables below
 
     // Flag array to track which timer instances are already enabled
 #ifdef __SAMD21J18A__
     static inline bool timer_enabled_[7] = {false}; // TCC0, TCC1, TCC2, TC3, TC4, TC5, TC6
+    static inline uint32_t timer_frequency_[7] = {0};
 #else
     static inline bool timer_enabled_[6] = {false}; // TCC0, TCC1, TCC2, TC3, TC4, TC5
+    static inline uint32_t timer_frequency_[6] = {0};
 #endif
 
     // Map a pin to its timer channel
     void MapPinToTimer();
 
+    // Set the timer period for the given input clock
+    void SetPeriod(uint32_t clock_frequency);
+
+    // Recompute period and duty cycle after a core clock change
+    static void OnClockChange(void *context, uint32_t frequency);
+
     // Synchronization helper functions
     inline void SyncTC(Tc *TCx);
     inline void SyncTCC(Tcc *TCCx);
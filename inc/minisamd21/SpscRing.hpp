@@ -0,0 +1,68 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace minisamd21
+{
+
+/**
+ * @brief Lock-free ring buffer for one producer and one consumer.
+ *
+ * Meant to pass records from an interrupt (producer) to the main loop (consumer)
+ * without masking interrupts: each side only writes its own index. Size must be a
+ * power of two; all Size entries are usable.
+ */
+template <typename T, size_t Size>
+class SpscRing
+{
+    static_assert(Size > 0 && (Size & (Size - 1)) == 0, "Size must be a power of two");
+    static_assert(Size <= 0x8000, "Size must fit the 16-bit indices");
+
+public:
+    // Producer side, returns false if the ring is full
+    bool Push(const T &item)
+    {
+        uint16_t head = head_.load(std::memory_order_relaxed);
+        if (static_cast<uint16_t>(head - tail_.load(std::memory_order_acquire)) >= Size)
+        {
+            return false;
+        }
+        items_[head & (Size - 1)] = item;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side, returns false if the ring is empty
+    bool Pop(T &item)
+    {
+        uint16_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail == head_.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        item = items_[tail & (Size - 1)];
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool IsEmpty() const
+    {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+    // Number of entries waiting
+    size_t GetCount() const
+    {
+        return static_cast<uint16_t>(head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire));
+    }
+
+private:
+    T items_[Size] = {};
+
+    // Free running, wrapped with Size on access
+    std::atomic<uint16_t> head_{0}; // Written by the producer only
+    std::atomic<uint16_t> tail_{0}; // Written by the consumer only
+};
+
+}
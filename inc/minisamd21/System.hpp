@@ -1,11 +1,26 @@
 #pragma once
+#include <coroutine>
 #include <cstdint>
+#include "minisamd21/Delegate.hpp"
+
+// Keep a variable out of the startup initialization, it survives a warm reset
+// (watchdog, software reset) but holds garbage after power-up
+#define MINISAMD21_NOINIT __attribute__((section(".noinit")))
 
 namespace minisamd21
 {
 
 /**
  * @brief System class with common helper functions.
+ *
+ * Time is kept by the RTC running as a free 32-bit counter from a 32.768kHz clock.
+ * The counter keeps running in standby, so there is no periodic tick interrupt;
+ * the RTC overflow extends the count to 64 bits (roughly once every 36 hours) and
+ * the compare channel is only armed to wake up for the next software timer.
+ *
+ * The cycle counter (SysTick) does interrupt on each 24-bit wrap, about 3 times a
+ * second at 48MHz. Sleep::SleepNow() stops it for the sleep and adds the time slept,
+ * from the RTC, on wake-up, so it never wakes the core.
  */
 class System
 {
@@ -16,28 +31,288 @@ public:
         EXTERNAL_XTAL // External 32.768kHz crystal
     };
 
+    // Core clock levels selectable at runtime (GCLK0 divider from the DFLL)
+    enum class PerformanceLevel
+    {
+        HIGH,   // 48MHz
+        MEDIUM, // 8MHz
+        LOW     // 1MHz
+    };
+
+    // Called after the core clock changed, with the new frequency in Hz
+    using ClockChangeCallback = void (*)(void *context, uint32_t frequency);
+
+    // Called from ProcessTimers(), may capture one pointer (an object, a coroutine handle)
+    using TimerCallback = Delegate<void(), sizeof(void *)>;
+
+    // Handle of a started timer, stale handles of expired or stopped timers are ignored
+    using TimerId = uint16_t;
+    static constexpr TimerId INVALID_TIMER = 0xFFFF;
+
     // Function to initialize the system with selected oscillator source
+    // EXTERNAL_XTAL locks the DFLL to the crystal and falls back to open-loop if it fails
     static void Init(ClockSource source);
 
+    // Get the core clock frequency (measured against the crystal when running closed-loop)
+    static uint32_t GetFrequency();
+
+    // Get the DFLL output frequency, measured like GetFrequency() (the core clock divides it)
+    static uint32_t GetDfllFrequency();
+
+    // Get the clock source actually in use (INTERNAL_OSC after a crystal fallback)
+    static ClockSource GetClockSource();
+
+    // Change the core clock and retime all subscribed drivers
+    static void SetPerformanceLevel(PerformanceLevel level);
+
+    // Get the current performance level
+    static PerformanceLevel GetPerformanceLevel();
+
+    // Register a driver to be retimed on core clock changes (returns false if the list is full)
+    static bool SubscribeClockChange(ClockChangeCallback callback, void *context);
+
+    // Remove a driver from the clock change list
+    static void UnsubscribeClockChange(ClockChangeCallback callback, void *context);
+
     // Delay for specified milliseconds
     static void DelayMs(uint64_t delay_ms);
-    
-    // Delay for specified microseconds (approximately)
+
+    // Delay for specified microseconds
     static void DelayUs(uint32_t delay_us);
 
-    // Get the number of milliseconds elapsed (tracked by System)
+    // Delay for specified nanoseconds (resolution is one core cycle)
+    static void DelayNs(uint32_t delay_ns);
+
+    /**
+     * @brief Delay for the specified number of core cycles.
+     *
+     * The busy loop runs from RAM and is calibrated against SysTick in Init(),
+     * so flash wait states, optimization level and call overhead are accounted for.
+     * With interrupts not firing the delay is never shorter than requested and at most
+     * one loop iteration (3 cycles) longer. Requests below the fixed call overhead
+     * (tens of cycles at -O0) return after that overhead.
+     */
+    static void DelayCycles(uint32_t cycles);
+
+    // Get the number of milliseconds elapsed (derived from the timebase ticks)
     static uint64_t GetMs();
 
-    // Increment millisecond counter (called by ISR)
-    static void Tick();
+    // Get the number of timebase ticks elapsed (TICK_FREQUENCY per second)
+    static uint64_t GetTicks();
+
+    // Get the number of CPU cycles elapsed (tear-free, time asleep is counted at RTC resolution)
+    static uint64_t GetCycles();
+
+    // Get the number of microseconds elapsed (derived from GetCycles)
+    static uint64_t GetUs();
+
+    // Get the core cycles from reset to main(), counted at the reset clock (1MHz)
+    static uint32_t GetBootCycles();
+
+    /**
+     * @brief Start a one-shot software timer.
+     *
+     * Timers live in a hierarchical wheel with a fixed pool of MAX_TIMERS entries, starting and
+     * stopping is O(1) and safe from interrupts. Resolution is 1/TIMER_FREQUENCY, the callback
+     * never runs earlier than requested. Delays are limited to about 12 days.
+     *
+     * @return Timer handle, or INVALID_TIMER if the pool is exhausted.
+     */
+    static TimerId StartTimer(uint32_t delay_ms, TimerCallback callback);
+
+    // Start a periodic software timer, first expiry after one period
+    static TimerId StartPeriodicTimer(uint32_t period_ms, TimerCallback callback);
+
+    // Cancel a timer (returns false if it already expired or was stopped)
+    static bool StopTimer(TimerId id);
+
+    // Run the callbacks of expired timers, call this from the main loop
+    static void ProcessTimers();
+
+    // Awaitable returned by Sleep()
+    struct SleepAwaiter
+    {
+        uint32_t delay_ms;
+
+        bool await_ready() const { return false; }
+        bool await_suspend(std::coroutine_handle<> handle) const;
+        void await_resume() const {}
+    };
+
+    // Suspend the calling coroutine without blocking the core (co_await System::Sleep(ms))
+    static SleepAwaiter Sleep(uint32_t delay_ms) { return {delay_ms}; }
+
+    // Get the timebase tick of the earliest pending timer (returns false if there is none)
+    static bool GetNextDeadline(uint64_t &ticks);
+
+    // Wake up from sleep when the timebase reaches the given tick
+    // Returns false if the tick is too close to program, do not go to sleep then
+    static bool SetWakeup(uint64_t ticks);
+
+    // Stop the cycle counter before sleeping and catch it up from the timebase after,
+    // both with interrupts disabled
+    static void SuspendCycleCounter();
+    static void ResumeCycleCounter();
+
+    // Convert between timebase ticks and milliseconds
+    static constexpr uint64_t TicksToMs(uint64_t ticks) { return (ticks * 1000) / TICK_FREQUENCY; }
+    static constexpr uint64_t MsToTicks(uint64_t ms) { return (ms * TICK_FREQUENCY) / 1000; }
+
+    // Called by the RTC_Handler
+    // You should not call this directly
+    static void TimebaseInterruptHandler();
+
+    // Called by the SysTick_Handler
+    // You should not call this directly
+    static void CycleCounterInterruptHandler();
 
-    // System clock frequency
+    // Nominal system clock frequency, use GetFrequency() for the actual one
     static constexpr uint32_t FREQUENCY = 48000000; // 48MHz
 
+    // Timebase frequency (RTC counter clock)
+    static constexpr uint32_t TICK_FREQUENCY = 32768;
+
+    // Maximum number of clock change subscribers
+    static constexpr uint8_t MAX_CLOCK_SUBSCRIBERS = 16;
+
+    // Size of the software timer pool
+    static constexpr uint16_t MAX_TIMERS = 256;
+
+    // Software timer resolution (32 timebase ticks, ~0.98ms)
+    static constexpr uint8_t TIMER_TICK_SHIFT = 5;
+    static constexpr uint32_t TIMER_FREQUENCY = TICK_FREQUENCY >> TIMER_TICK_SHIFT;
+
+    // SysTick reload value used for the cycle counter (full 24-bit range)
+    static constexpr uint32_t SYSTICK_RELOAD = 0x00FFFFFF;
+
 private:
+    // DFLL closed-loop multiplier (48MHz / 32.768kHz)
+    static constexpr uint32_t DFLL_MULTIPLIER = FREQUENCY / TICK_FREQUENCY;
+
+    // XOSC32K startup time (16384 cycles, ~0.5s) and how long to wait for it
+    static constexpr uint8_t XOSC32K_STARTUP = 4;
+    static constexpr uint32_t XOSC32K_TIMEOUT_MS = 2000;
+
+    // How long to wait for the DFLL to lock
+    static constexpr uint32_t DFLL_LOCK_TIMEOUT_MS = 100;
+
+    // Highest core clock that runs from flash without wait states
+    static constexpr uint32_t MAX_ZERO_WAIT_FREQUENCY = 24000000;
+
+    // Frequency measurement window (1/16 s)
+    static constexpr uint32_t MEASURE_TICKS = TICK_FREQUENCY / 16;
+
+    // Calibrated delay loop (cycles per iteration and fixed overhead of DelayCycles)
+    static inline uint32_t delay_loop_cycles_ = 3;
+    static inline uint32_t delay_overhead_ = 0;
+
+    // Overhead measured with 0 and 1 flash wait states, the code outside the RAM loop runs from flash
+    static constexpr uint32_t DELAY_NOT_CALIBRATED = UINT32_MAX;
+    static inline uint32_t delay_overheads_[2] = {DELAY_NOT_CALIBRATED, DELAY_NOT_CALIBRATED};
+
+    // Actual core clock
+    static inline uint32_t frequency_ = FREQUENCY;
+    static inline uint32_t cycles_per_us_ = FREQUENCY / 1000000;
+    static inline uint32_t dfll_frequency_ = FREQUENCY;
+    static inline ClockSource clock_source_ = ClockSource::INTERNAL_OSC;
+    static inline PerformanceLevel performance_level_ = PerformanceLevel::HIGH;
+
+    // GetUs() keeps counting across clock changes from this point
+    static inline uint64_t us_base_ = 0;
+    static inline uint64_t us_base_cycles_ = 0;
+
+    struct ClockSubscriber
+    {
+        ClockChangeCallback callback;
+        void *context;
+    };
+    static inline ClockSubscriber clock_subscribers_[MAX_CLOCK_SUBSCRIBERS] = {};
+
+    // Generic clock generators of the timebase and the crystal (DFLL reference)
+    static inline uint8_t timebase_gclk_ = 0xFF;
+    static inline uint8_t xosc32k_gclk_ = 0xFF;
+
+    // Timer wheel: 4 levels of 64 slots, level n slots are 64^n timer ticks wide
+    static constexpr uint8_t TIMER_LEVELS = 4;
+    static constexpr uint8_t TIMER_SLOT_BITS = 6;
+    static constexpr uint16_t TIMER_SLOTS = 1 << TIMER_SLOT_BITS;
+
+    // Besides the wheel slots, timers are on the expired list or the free list
+    static constexpr uint16_t TIMER_EXPIRED_LIST = TIMER_LEVELS * TIMER_SLOTS;
+    static constexpr uint16_t TIMER_FREE_LIST = TIMER_EXPIRED_LIST + 1;
+    static constexpr uint16_t TIMER_NONE = 0xFFFF;
+
+    // Longest delay in timer ticks, keeps 32-bit expiry arithmetic unambiguous
+    static constexpr uint32_t MAX_TIMER_DELAY = 0x3FFFFFFF;
+
+    // Closest wakeup that can still be programmed (RTC write synchronization takes a few ticks)
+    static constexpr uint32_t WAKEUP_MARGIN_TICKS = 8;
+
+    struct Timer
+    {
+        TimerCallback callback;
+        uint32_t expiry; // Lower 32 bits of the expiry in timer ticks
+        uint32_t period; // 0 for one-shot timers
+        uint16_t next;
+        uint16_t prev;
+        uint16_t list;
+        uint8_t generation; // Bumped on every release, part of the TimerId
+    };
+    static inline Timer timers_[MAX_TIMERS] = {};
+    static inline uint16_t timer_lists_[TIMER_FREE_LIST + 1] = {};
+    static inline uint16_t timer_level_count_[TIMER_LEVELS] = {};
+
+    // Next timer tick to be processed, all earlier ticks are done
+    static inline uint64_t timer_time_ = 0;
+
+    // Upper 32 bits of the timebase, incremented on each RTC overflow
+    static inline volatile uint32_t timebase_overflows_ = 0;
+
+    // Cycles accumulated by completed SysTick wraps
+    static inline volatile uint64_t cycles_ = 0;
+
+    // Timebase tick at which the cycle counter was suspended
+    static inline uint64_t suspend_ticks_ = 0;
+
+    // Configure the RTC as the free-running timebase
+    static void InitTimebase();
+
+    // Configure SysTick as the free-running cycle counter
+    static void InitCycleCounter();
+
+    // Delay loop and its calibration
+    // DelayLoop lives in RAM, long_call because it is out of BL range from flash
+    __attribute__((long_call)) static void DelayLoop(uint32_t iterations);
+    static void CalibrateDelay();
+    static uint32_t MeasureCycles(void (*function)(uint32_t), uint32_t argument);
+
+    // Clock startup helpers
+    static bool StartXosc32k();
+    static bool StartDfllClosedLoop();
+    static void StartDfllOpenLoop();
+    static bool WaitForClockStatus(uint32_t mask, uint32_t timeout_ms);
+
+    // Count core cycles against the timebase
+    static uint32_t MeasureFrequency();
+
+    // Store the core clock frequency and derived constants
+    static void SetFrequency(uint32_t frequency);
+
+    // Wait for RTC register synchronization
+    static void SyncRtc();
 
-    // Internal millisecond counter
-    static inline uint64_t millis_ = 0;
+    // Timer wheel internals, list operations expect interrupts to be disabled
+    static void InitTimers();
+    static TimerId AddTimer(uint32_t delay_ms, bool periodic, TimerCallback callback);
+    static uint32_t MsToTimerTicks(uint32_t ms);
+    static uint64_t GetTimerExpiry(const Timer &timer);
+    static void InsertTimer(uint16_t index, uint64_t expiry);
+    static void LinkTimer(uint16_t index, uint16_t list);
+    static void UnlinkTimer(uint16_t index);
+    static void FreeTimer(uint16_t index);
+    static void CascadeTimers(uint8_t level, uint16_t slot);
+    static uint64_t GetNextTimerTick(uint64_t tick, uint64_t now);
+    static void RunExpiredTimers();
 };
 
 }
@@ -1,4 +1,5 @@
 #pragma once
+#include "minisamd21/Executor.hpp"
 #include "minisamd21/I2C.hpp"
 
 namespace minisamd21
@@ -79,11 +80,38 @@ public:
      */
     bool Read(uint16_t address, uint8_t *data, uint32_t length);
 
+    /**
+     * @brief Write multiple bytes without blocking the core.
+     *
+     * Same as Write(), but the transfers and the write cycle time suspend the calling
+     * coroutine (co_await eeprom.WriteAsync(...)), so other workflows keep running.
+     *
+     * @param address The starting address within the EEPROM to write to.
+     * @param data Pointer to the data to write, must stay valid until the task completes.
+     * @param length The number of bytes to write.
+     * @return Task resulting in true if the write was acknowledged, false otherwise.
+     */
+    Task<bool> WriteAsync(uint16_t address, const uint8_t *data, uint32_t length);
+
+    /**
+     * @brief Read multiple bytes without blocking the core.
+     *
+     * @param address The starting address within the EEPROM to read from.
+     * @param data Pointer to the buffer where the read data will be stored.
+     * @param length The number of bytes to read.
+     * @return Task resulting in true if the read was acknowledged, false otherwise.
+     */
+    Task<bool> ReadAsync(uint16_t address, uint8_t *data, uint32_t length);
+
     static AT24XX AT24C32(I2C &i2c, uint8_t device_address = DEFAULT_ADDRESS);
     static AT24XX AT24C256(I2C &i2c, uint8_t device_address = DEFAULT_ADDRESS);
     static AT24XX AT24C512(I2C &i2c, uint8_t device_address = DEFAULT_ADDRESS);
 
 private:
+    static constexpr uint32_t WRITE_CYCLE_MS = 10; ///< Write cycle time, 10ms is enough for most EEPROMs
+    static constexpr uint32_t MAX_PAGE_SIZE = 128; ///< Largest page of the supported parts (AT24C512)
+
+    uint32_t FillAddress(uint16_t address, uint8_t *buffer) const;
     bool WritePage(uint16_t address, uint8_t *data, uint32_t length);
     bool ReadPage(uint16_t address, uint8_t *data, uint32_t length);
     bool WaitForWriteCompletion();
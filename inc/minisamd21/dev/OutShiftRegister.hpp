@@ -1,9 +1,18 @@
 #pragma once
 #include "minisamd21/Pin.hpp"
+#include "minisamd21/System.hpp"
 #include "cstdint"
 
 namespace minisamd21
 {
+
+/**
+ * @brief Bit-banged output shift register (74HC595 and others).
+ *
+ * The pins can be Pin or FastPin<Port, N>, each independently. With FastPin every
+ * pin write is a single store.
+ */
+template <typename DataPin = Pin, typename ClockPin = DataPin, typename LatchPin = DataPin>
 class OutShiftRegister
 {
 public:
@@ -13,17 +22,55 @@ public:
         LSB_FIRST
     };
 
-    OutShiftRegister(Pin data, Pin clock, Pin latch, Endian endian = Endian::MSB_FIRST)
+    OutShiftRegister(DataPin data, ClockPin clock, LatchPin latch, Endian endian = Endian::MSB_FIRST)
         : data_(data), clock_(clock), latch_(latch), endian_(endian) {
           };
 
     // Initialize the pins
-    void Init();
+    void Init()
+    {
+        data_.Init(Pin::Mode::OUTPUT);
+        clock_.Init(Pin::Mode::OUTPUT);
+        latch_.Init(Pin::Mode::OUTPUT);
+        data_.Write(false);
+        clock_.Write(false);
+        latch_.Write(false);
+    }
 
-    void DeInit();
+    void DeInit()
+    {
+        data_.DeInit();
+        clock_.DeInit();
+        latch_.DeInit();
+    }
 
     // length is in bytes
-    void Write(uint8_t *data, std::size_t length);
+    void Write(uint8_t *data, std::size_t length)
+    {
+        const std::size_t total_bits = length * 8;
+
+        latch_.Write(false); // Begin latch
+        System::DelayUs(2);  // Small delay to ensure latch works
+        for (std::size_t i = 0; i < total_bits; ++i)
+        {
+            bool bit;
+            if (endian_ == Endian::MSB_FIRST)
+            {
+                bit = (data[i / 8] & (1 << (7 - (i % 8)))) != 0;
+            }
+            else
+            {
+                bit = (data[i / 8] & (1 << (i % 8))) != 0;
+            }
+
+            data_.Write(bit);
+            clock_.Write(true);
+            System::DelayUs(2); // Small delay to ensure clock pulse
+            clock_.Write(false);
+        }
+
+        latch_.Write(true); // End latch
+    }
 
     void WriteByte(uint8_t data)
     {
@@ -32,10 +79,10 @@ public:
     }
 
 private:
-    Pin data_;
-    Pin clock_;
-    Pin latch_;
+    DataPin data_;
+    ClockPin clock_;
+    LatchPin latch_;
     Endian endian_;
 };
 
-}
\ No newline at end of file
+}
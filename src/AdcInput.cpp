@@ -1,8 +1,15 @@
 #include "minisamd21/AdcInput.hpp"
 #include "samd21.h"
+#include "minisamd21/EventSystem.hpp"
+#include "minisamd21/Executor.hpp"
+#include "minisamd21/Flash.hpp"
+#include "minisamd21/System.hpp"
 
 using namespace minisamd21;
 
+// Requests of ReadAsync(callback), shared by all inputs
+static AdcInput::Request request_pool[AdcInput::REQUEST_POOL_SIZE];
+
 uint8_t AdcInput::MapPinToChannel(Pin pin)
 {
     uint8_t pin_no = pin.GetPin();
@@ -64,16 +71,22 @@ AdcInput::AdcInput(Pin pin) : pin_(pin)
 }
 
 void AdcInput::Init(Resolution res, Reference ref)
+{
+    InitAdc(res, ref);
+    ConfigurePin(pin_);
+
+    // Enable ADC
+    ADC->CTRLA.bit.ENABLE = 1;
+    SyncBusy();
+}
+
+void AdcInput::InitAdc(Resolution res, Reference ref)
 {
     // Enable the APBC clock for the ADC
     PM->APBCMASK.reg |= PM_APBCMASK_ADC;
 
     // Set up the GCLK for ADC
-    GCLK->CLKCTRL.reg = GCLK_CLKCTRL_CLKEN |
-                        GCLK_CLKCTRL_GEN_GCLK0 |
-                        GCLK_CLKCTRL_ID_ADC;
-    while (GCLK->STATUS.bit.SYNCBUSY)
-        ;
+    GenericClock::Connect(GCLK_CLKCTRL_ID_ADC_Val, GenericClock::MAIN);
 
     // Reset the ADC
     ADC->CTRLA.bit.SWRST = 1;
@@ -81,6 +94,8 @@ void AdcInput::Init(Resolution res, Reference ref)
     while (ADC->CTRLA.bit.SWRST)
         ;
 
+    LoadFactoryCalibration();
+
     SetAveraging(Averaging::SAMPLES_64);
 
     // Set reference
@@ -95,8 +110,106 @@ void AdcInput::Init(Resolution res, Reference ref)
     // Set sample time length
     ADC->SAMPCTRL.reg = ADC_SAMPCTRL_SAMPLEN(32);
 
-    uint8_t pin_no = pin_.GetPin();
-    uint8_t port_no = static_cast<uint8_t>(pin_.GetPort());
+    // User offset and gain correction, if one was saved
+    LoadCalibration();
+
+    // Result interrupt is only enabled while asynchronous reads are queued
+    NVIC_SetPriority(ADC_IRQn, 1);
+    NVIC_EnableIRQ(ADC_IRQn);
+}
+
+void AdcInput::LoadFactoryCalibration()
+{
+    uint32_t bias = (*reinterpret_cast<const uint32_t *>(ADC_FUSES_BIASCAL_ADDR) & ADC_FUSES_BIASCAL_Msk) >>
+                    ADC_FUSES_BIASCAL_Pos;
+
+    // Linearity is split over two words
+    uint32_t linearity = (*reinterpret_cast<const uint32_t *>(ADC_FUSES_LINEARITY_0_ADDR) & ADC_FUSES_LINEARITY_0_Msk) >>
+                         ADC_FUSES_LINEARITY_0_Pos;
+    linearity |= ((*reinterpret_cast<const uint32_t *>(ADC_FUSES_LINEARITY_1_ADDR) & ADC_FUSES_LINEARITY_1_Msk) >>
+                  ADC_FUSES_LINEARITY_1_Pos)
+                 << 5;
+
+    ADC->CALIB.reg = ADC_CALIB_BIAS_CAL(bias) | ADC_CALIB_LINEARITY_CAL(linearity);
+}
+
+AdcInput::Calibration AdcInput::ComputeCalibration(uint16_t raw_low, uint16_t expected_low,
+                                                   uint16_t raw_high, uint16_t expected_high)
+{
+    int32_t raw_span = static_cast<int32_t>(raw_high) - raw_low;
+    int32_t expected_span = static_cast<int32_t>(expected_high) - expected_low;
+    if (raw_span <= 0 || expected_span <= 0)
+    {
+        return {0, GAIN_ONE};
+    }
+
+    // result = (raw - offset) * gain / GAIN_ONE through both points
+    int32_t gain = (expected_span * GAIN_ONE + raw_span / 2) / raw_span;
+    gain = gain < 1024 ? 1024 : (gain > 4095 ? 4095 : gain);
+
+    int32_t offset = raw_low - (static_cast<int32_t>(expected_low) * GAIN_ONE + gain / 2) / gain;
+    offset = offset < -2048 ? -2048 : (offset > 2047 ? 2047 : offset);
+
+    return {static_cast<int16_t>(offset), static_cast<uint16_t>(gain)};
+}
+
+void AdcInput::SetCalibration(const Calibration &calibration)
+{
+    ADC->OFFSETCORR.reg = ADC_OFFSETCORR_OFFSETCORR(calibration.offset);
+    SyncBusy();
+    ADC->GAINCORR.reg = ADC_GAINCORR_GAINCORR(calibration.gain);
+    SyncBusy();
+    ADC->CTRLB.reg |= ADC_CTRLB_CORREN;
+    SyncBusy();
+}
+
+AdcInput::Calibration AdcInput::GetCalibration()
+{
+    if (!(ADC->CTRLB.reg & ADC_CTRLB_CORREN))
+    {
+        return {0, GAIN_ONE};
+    }
+
+    // OFFSETCORR is a 12-bit two's complement value
+    int16_t offset = static_cast<int16_t>(ADC->OFFSETCORR.reg << 4) >> 4;
+    return {offset, static_cast<uint16_t>(ADC->GAINCORR.reg)};
+}
+
+void AdcInput::ClearCalibration()
+{
+    ADC->CTRLB.reg &= ~ADC_CTRLB_CORREN;
+    SyncBusy();
+}
+
+uint16_t AdcInput::CalibrationSetup()
+{
+    return static_cast<uint16_t>((ADC->CTRLB.bit.RESSEL << 8) |
+                                 (ADC->REFCTRL.bit.REFSEL << 4) |
+                                 ADC->INPUTCTRL.bit.GAIN);
+}
+
+bool AdcInput::SaveCalibration()
+{
+    StoredCalibration stored = {CALIBRATION_MAGIC, GetCalibration(), CalibrationSetup()};
+    return Flash::WriteSettings(&stored, sizeof(stored));
+}
+
+bool AdcInput::LoadCalibration()
+{
+    const StoredCalibration *stored = static_cast<const StoredCalibration *>(Flash::GetSettings());
+    if (stored->magic != CALIBRATION_MAGIC || stored->setup != CalibrationSetup())
+    {
+        return false;
+    }
+
+    SetCalibration(stored->calibration);
+    return true;
+}
+
+void AdcInput::ConfigurePin(Pin pin)
+{
+    uint8_t pin_no = pin.GetPin();
+    uint8_t port_no = static_cast<uint8_t>(pin.GetPort());
 
     // Configure pin as analog input
     PORT->Group[port_no].DIRCLR.reg = (1 << pin_no);    // Set as input
@@ -110,13 +223,14 @@ void AdcInput::Init(Resolution res, Reference ref)
     {
         PORT->Group[port_no].PMUX[pin_no >> 1].bit.PMUXE = 0x1; // Function B (ADC)
     }
-    // Enable ADC
-    ADC->CTRLA.bit.ENABLE = 1;
-    SyncBusy();
 }
 
 uint16_t AdcInput::Read() const
 {
+    // Let queued asynchronous reads finish first, they own the result flag
+    while (pending_head_ != nullptr)
+        ;
+
     // Select the ADC input channel
     ADC->INPUTCTRL.bit.MUXPOS = channel_;
 
@@ -134,6 +248,369 @@ uint16_t AdcInput::Read() const
     return ADC->RESULT.reg;
 }
 
+void AdcInput::SetStartEvent(uint8_t channel)
+{
+    if (channel == EventSystem::NONE)
+    {
+        ADC->EVCTRL.reg &= ~ADC_EVCTRL_STARTEI;
+        EventSystem::Disconnect(EVSYS_ID_USER_ADC_START);
+        return;
+    }
+
+    ADC->INPUTCTRL.bit.MUXPOS = channel_;
+    SyncBusy();
+
+    ADC->EVCTRL.reg |= ADC_EVCTRL_STARTEI;
+    EventSystem::Connect(channel, EVSYS_ID_USER_ADC_START);
+}
+
+bool AdcInput::ReadResult(uint16_t &value) const
+{
+    if (!(ADC->INTFLAG.reg & ADC_INTFLAG_RESRDY))
+    {
+        return false;
+    }
+
+    // Reading the result clears the flag
+    value = ADC->RESULT.reg;
+    return true;
+}
+
+bool AdcInput::StartStream(uint16_t *buffer, uint16_t size, StreamCallback callback)
+{
+    if (!SetupStream(buffer, size, callback))
+    {
+        return false;
+    }
+
+    ADC->CTRLB.reg |= ADC_CTRLB_FREERUN;
+    ADC->INTFLAG.reg = ADC_INTFLAG_RESRDY | ADC_INTFLAG_OVERRUN;
+    Dma::Enable(stream_dma_);
+    ADC->CTRLA.bit.ENABLE = 1;
+    SyncBusy();
+
+    // Free-running after the first trigger
+    ADC->SWTRIG.bit.START = 1;
+    SyncBusy();
+    return true;
+}
+
+bool AdcInput::StartSampling(uint32_t rate, uint16_t *buffer, uint16_t size, StreamCallback callback)
+{
+    uint8_t prescaler;
+    uint32_t period;
+    if (rate > STREAM_RATE || !ComputeSamplingTimer(System::GetFrequency(), rate, prescaler, period))
+    {
+        return false;
+    }
+
+    uint8_t event = EventSystem::Acquire(EVSYS_ID_GEN_TC3_OVF);
+    if (event == EventSystem::NONE)
+    {
+        return false;
+    }
+    if (!SetupStream(buffer, size, callback))
+    {
+        EventSystem::Release(event);
+        return false;
+    }
+    sampling_event_ = event;
+    sampling_requested_rate_ = rate;
+
+    // Each conversion is started by the timer overflow, no software in the loop
+    SetStartEvent(sampling_event_);
+    ADC->INTFLAG.reg = ADC_INTFLAG_RESRDY | ADC_INTFLAG_OVERRUN;
+    Dma::Enable(stream_dma_);
+    ADC->CTRLA.bit.ENABLE = 1;
+    SyncBusy();
+
+    PM->APBCMASK.reg |= PM_APBCMASK_TC3;
+    GenericClock::Connect(GCLK_CLKCTRL_ID_TCC2_TC3_Val, GenericClock::MAIN);
+
+    TC3->COUNT16.CTRLA.reg = TC_CTRLA_SWRST;
+    while (TC3->COUNT16.CTRLA.reg & TC_CTRLA_SWRST)
+        ;
+
+    ProgramSamplingTimer(System::GetFrequency(), prescaler, period);
+
+    // GCLK0 follows the performance level, keep the rate across changes
+    System::SubscribeClockChange(OnClockChange, nullptr);
+    return true;
+}
+
+bool AdcInput::ComputeSamplingTimer(uint32_t frequency, uint32_t rate, uint8_t &prescaler, uint32_t &period)
+{
+    if (rate == 0)
+    {
+        return false;
+    }
+
+    // Timer clocks per sample, with the smallest prescaler that fits 16 bits
+    uint32_t ticks = (frequency + rate / 2) / rate;
+    prescaler = 0;
+    while (prescaler < 7 && (ticks >> PRESCALER_SHIFTS[prescaler]) > 0x10000)
+    {
+        prescaler++;
+    }
+    period = ticks >> PRESCALER_SHIFTS[prescaler];
+    return period >= 2 && period <= 0x10000;
+}
+
+void AdcInput::ProgramSamplingTimer(uint32_t frequency, uint8_t prescaler, uint32_t period)
+{
+    TC3->COUNT16.CTRLA.reg &= ~TC_CTRLA_ENABLE;
+    SyncTC3();
+
+    // Match frequency: the counter wraps at CC0, one overflow event per sample
+    TC3->COUNT16.CTRLA.reg = TC_CTRLA_MODE_COUNT16 | TC_CTRLA_WAVEGEN_MFRQ | TC_CTRLA_PRESCALER(prescaler);
+    SyncTC3();
+    TC3->COUNT16.COUNT.reg = 0;
+    SyncTC3();
+    TC3->COUNT16.CC[0].reg = period - 1;
+    SyncTC3();
+    TC3->COUNT16.EVCTRL.reg = TC_EVCTRL_OVFEO;
+
+    TC3->COUNT16.CTRLA.reg |= TC_CTRLA_ENABLE;
+    SyncTC3();
+
+    sampling_rate_ = frequency / (period << PRESCALER_SHIFTS[prescaler]);
+}
+
+void AdcInput::OnClockChange(void *context, uint32_t frequency)
+{
+    (void)context;
+
+    uint8_t prescaler;
+    uint32_t period;
+    if (ComputeSamplingTimer(frequency, sampling_requested_rate_, prescaler, period))
+    {
+        ProgramSamplingTimer(frequency, prescaler, period);
+        return;
+    }
+
+    // The core clock is too slow for the rate, pause until it is fast enough again
+    TC3->COUNT16.CTRLA.reg &= ~TC_CTRLA_ENABLE;
+    SyncTC3();
+    sampling_rate_ = 0;
+}
+
+bool AdcInput::SetupStream(uint16_t *buffer, uint16_t size, StreamCallback callback)
+{
+    if (stream_buffer_ != nullptr || size < 2 || (size & 1))
+    {
+        return false;
+    }
+
+    stream_dma_ = Dma::Acquire(ADC_DMAC_ID_RESRDY, Dma::TriggerAction::BEAT, 1);
+    if (stream_dma_ == Dma::NONE)
+    {
+        return false;
+    }
+
+    // Own clock, the stream rate does not follow core clock changes. The core clock
+    // can be too slow for STREAM_RATE, so there is no falling back to it.
+    stream_generator_ = GenericClock::Acquire(GenericClock::Source::DFLL48M, 48000000 / STREAM_CLOCK);
+    if (stream_generator_ == GenericClock::NONE)
+    {
+        Dma::Release(stream_dma_);
+        stream_dma_ = Dma::NONE;
+        return false;
+    }
+
+    stream_buffer_ = buffer;
+    stream_size_ = size;
+    stream_callback_ = callback;
+
+    // One block per half, the two chained in a ring
+    uint16_t half = size / 2;
+    DmacDescriptor &first = Dma::GetDescriptor(stream_dma_);
+    DmacDescriptor &second = stream_descriptor_;
+    Dma::SetTransfer(first, &ADC->RESULT.reg, false, buffer, true, half, Dma::BeatSize::HWORD, true, &second);
+    Dma::SetTransfer(second, &ADC->RESULT.reg, false, buffer + half, true, half, Dma::BeatSize::HWORD, true, &first);
+    Dma::SetCallback(stream_dma_, &AdcInput::OnStreamBlock);
+
+    ADC->CTRLA.bit.ENABLE = 0;
+    SyncBusy();
+
+    saved_ctrlb_ = ADC->CTRLB.reg;
+    saved_sampctrl_ = ADC->SAMPCTRL.reg;
+    saved_avgctrl_ = ADC->AVGCTRL.reg;
+
+    GenericClock::Connect(GCLK_CLKCTRL_ID_ADC_Val, stream_generator_);
+
+    ADC->CTRLB.reg = (saved_ctrlb_ & ~ADC_CTRLB_PRESCALER_Msk) | ADC_CTRLB_PRESCALER_DIV4;
+    ADC->SAMPCTRL.reg = ADC_SAMPCTRL_SAMPLEN(0);
+    ADC->AVGCTRL.reg = ADC_AVGCTRL_SAMPLENUM_1 | ADC_AVGCTRL_ADJRES(0);
+    ADC->INPUTCTRL.bit.MUXPOS = channel_;
+    SyncBusy();
+
+    // Left disabled for the caller to pick the trigger, the DMA is enabled once a stale
+    // RESRDY is cleared so it can't move an old result into the buffer
+    return true;
+}
+
+void AdcInput::StopStream()
+{
+    if (stream_buffer_ == nullptr)
+    {
+        return;
+    }
+
+    if (sampling_event_ != EventSystem::NONE)
+    {
+        System::UnsubscribeClockChange(OnClockChange, nullptr);
+        TC3->COUNT16.CTRLA.reg &= ~TC_CTRLA_ENABLE;
+        SyncTC3();
+        SetStartEvent(EventSystem::NONE);
+        EventSystem::Release(sampling_event_);
+        sampling_event_ = EventSystem::NONE;
+        sampling_rate_ = 0;
+    }
+
+    ADC->CTRLA.bit.ENABLE = 0;
+    SyncBusy();
+
+    Dma::Release(stream_dma_);
+    stream_dma_ = Dma::NONE;
+
+    ADC->CTRLB.reg = saved_ctrlb_;
+    ADC->SAMPCTRL.reg = saved_sampctrl_;
+    ADC->AVGCTRL.reg = saved_avgctrl_;
+    SyncBusy();
+
+    if (stream_generator_ != GenericClock::NONE)
+    {
+        GenericClock::Connect(GCLK_CLKCTRL_ID_ADC_Val, GenericClock::MAIN);
+        GenericClock::Release(stream_generator_);
+        stream_generator_ = GenericClock::NONE;
+    }
+
+    ADC->INTFLAG.reg = ADC_INTFLAG_RESRDY | ADC_INTFLAG_OVERRUN;
+    ADC->CTRLA.bit.ENABLE = 1;
+    SyncBusy();
+
+    stream_callback_ = nullptr;
+    stream_buffer_ = nullptr;
+}
+
+void AdcInput::OnStreamBlock()
+{
+    // The half the DMA is not filling now is the one that completed last. Asking the DMA
+    // rather than alternating stays right when both halves completed before this runs.
+    uint16_t half = stream_size_ / 2;
+    bool first_filling = Dma::IsNext(stream_dma_, stream_descriptor_);
+    const uint16_t *samples = stream_buffer_ + (first_filling ? half : 0);
+    stream_callback_(samples, half);
+}
+
+bool AdcInput::ReadAsync(Request &request, ReadCallback callback) const
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (request.state_ == Request::State::PENDING)
+    {
+        __set_PRIMASK(primask);
+        return false;
+    }
+
+    request.adc_ = this;
+    request.done_ = callback;
+    request.next_ = nullptr;
+    request.state_ = Request::State::PENDING;
+
+    if (pending_head_ == nullptr)
+    {
+        pending_head_ = &request;
+        pending_tail_ = &request;
+        StartConversion(channel_);
+    }
+    else
+    {
+        pending_tail_->next_ = &request;
+        pending_tail_ = &request;
+    }
+
+    __set_PRIMASK(primask);
+    return true;
+}
+
+bool AdcInput::ReadAsync(ReadCallback callback) const
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    // Free pool entries are the ones not pending, ReadAsync() can't fail on them
+    bool started = false;
+    for (Request &request : request_pool)
+    {
+        if (!request.IsPending())
+        {
+            started = ReadAsync(request, callback);
+            break;
+        }
+    }
+
+    __set_PRIMASK(primask);
+    return started;
+}
+
+void AdcInput::ReadAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    adc_.ReadAsync(request_, [handle](uint16_t)
+                   { Executor::Schedule(handle); });
+}
+
+void AdcInput::StartConversion(uint8_t channel)
+{
+    ADC->INPUTCTRL.bit.MUXPOS = channel;
+    while (ADC->STATUS.bit.SYNCBUSY)
+        ;
+
+    ADC->INTFLAG.reg = ADC_INTFLAG_RESRDY;
+    ADC->INTENSET.reg = ADC_INTENSET_RESRDY;
+
+    ADC->SWTRIG.bit.START = 1;
+    while (ADC->STATUS.bit.SYNCBUSY)
+        ;
+}
+
+void AdcInput::InterruptHandler()
+{
+    if (!(ADC->INTFLAG.reg & ADC_INTFLAG_RESRDY))
+    {
+        return;
+    }
+
+    // Reading the result clears the flag
+    uint16_t result = ADC->RESULT.reg;
+
+    Request *done = pending_head_;
+    if (done == nullptr)
+    {
+        ADC->INTENCLR.reg = ADC_INTENCLR_RESRDY;
+        return;
+    }
+    done->result_ = result;
+
+    // Start the next queued read right away
+    pending_head_ = done->next_;
+    if (pending_head_ != nullptr)
+    {
+        StartConversion(pending_head_->adc_->channel_);
+    }
+    else
+    {
+        pending_tail_ = nullptr;
+        ADC->INTENCLR.reg = ADC_INTENCLR_RESRDY;
+    }
+
+    // The request may be reused from its callback
+    ReadCallback callback = done->done_;
+    done->state_ = Request::State::DONE;
+    callback(result);
+}
+
 void AdcInput::SetReference(Reference ref)
 {
     // No negative input (internal ground)
@@ -205,4 +682,9 @@ void AdcInput::SetAveraging(Averaging samples)
     ADC->AVGCTRL.reg = ADC_AVGCTRL_SAMPLENUM(sample_num) | ADC_AVGCTRL_ADJRES(adjres);
 
     SyncBusy();
-}
\ No newline at end of file
+}
+
+extern "C" void ADC_Handler(void)
+{
+    AdcInput::InterruptHandler();
+}
@@ -0,0 +1,168 @@
+#include "minisamd21/AdcScanGroup.hpp"
+#include "samd21.h"
+
+namespace minisamd21
+{
+
+AdcScanGroup::AdcScanGroup(std::initializer_list<Pin> pins)
+{
+    if (pins.size() == 0 || pins.size() > MAX_CHANNELS)
+    {
+        while (1)
+        {
+            // fail, a group has 1 to MAX_CHANNELS pins
+        }
+    }
+
+    uint8_t channels[MAX_CHANNELS];
+    uint8_t last_channel = 0;
+    first_channel_ = 0xFF;
+    for (const Pin &pin : pins)
+    {
+        uint8_t channel = AdcInput::MapPinToChannel(pin);
+        if (channel == 0xFF)
+        {
+            while (1)
+            {
+                // fail, invalid pin
+            }
+        }
+        first_channel_ = channel < first_channel_ ? channel : first_channel_;
+        last_channel = channel > last_channel ? channel : last_channel;
+        channels[count_] = channel;
+        pins_[count_++] = (static_cast<uint8_t>(pin.GetPort()) << 5) | pin.GetPin();
+    }
+
+    span_ = last_channel - first_channel_ + 1;
+    if (span_ > MAX_CHANNELS)
+    {
+        while (1)
+        {
+            // fail, the inputs are too far apart for one sweep
+        }
+    }
+
+    for (uint8_t i = 0; i < count_; ++i)
+    {
+        offsets_[i] = channels[i] - first_channel_;
+    }
+}
+
+AdcScanGroup::~AdcScanGroup()
+{
+    if (dma_channel_ != Dma::NONE)
+    {
+        if (busy_)
+        {
+            EndSweep();
+        }
+        Dma::Release(dma_channel_);
+    }
+}
+
+void AdcScanGroup::Init(AdcInput::Resolution res, AdcInput::Reference ref)
+{
+    AdcInput::InitAdc(res, ref);
+    for (uint8_t i = 0; i < count_; ++i)
+    {
+        AdcInput::ConfigurePin(Pin(static_cast<Pin::PortName>(pins_[i] >> 5), pins_[i] & 0x1F));
+    }
+
+    ADC->CTRLA.bit.ENABLE = 1;
+    AdcInput::SyncBusy();
+}
+
+void AdcScanGroup::Read(uint16_t *values)
+{
+    BeginSweep();
+
+    // Results come every conversion time, in channel order
+    for (uint8_t offset = 0; offset < span_; ++offset)
+    {
+        while (!(ADC->INTFLAG.reg & ADC_INTFLAG_RESRDY))
+            ;
+        results_[offset] = ADC->RESULT.reg;
+    }
+
+    EndSweep();
+    GetValues(values);
+}
+
+bool AdcScanGroup::StartScan(Callback done)
+{
+    if (busy_)
+    {
+        return false;
+    }
+
+    if (dma_channel_ == Dma::NONE)
+    {
+        dma_channel_ = Dma::Acquire(ADC_DMAC_ID_RESRDY, Dma::TriggerAction::BEAT, 1);
+        if (dma_channel_ == Dma::NONE)
+        {
+            return false;
+        }
+        Dma::SetCallback(dma_channel_, Dma::Callback::Bind<&AdcScanGroup::OnScanDone>(*this));
+    }
+
+    // One result per beat, the block ends with the sweep
+    Dma::SetTransfer(Dma::GetDescriptor(dma_channel_), &ADC->RESULT.reg, false, results_, true, span_,
+                     Dma::BeatSize::HWORD, true);
+
+    done_ = done;
+    busy_ = true;
+    Dma::Enable(dma_channel_);
+    BeginSweep();
+    return true;
+}
+
+void AdcScanGroup::GetValues(uint16_t *values) const
+{
+    for (uint8_t i = 0; i < count_; ++i)
+    {
+        values[i] = results_[offsets_[i]];
+    }
+}
+
+void AdcScanGroup::BeginSweep()
+{
+    // Let queued asynchronous reads of single inputs finish first
+    while (AdcInput::pending_head_ != nullptr)
+        ;
+
+    ADC->INPUTCTRL.reg = (ADC->INPUTCTRL.reg & ~(ADC_INPUTCTRL_MUXPOS_Msk | ADC_INPUTCTRL_INPUTSCAN_Msk |
+                                                 ADC_INPUTCTRL_INPUTOFFSET_Msk)) |
+                         ADC_INPUTCTRL_MUXPOS(first_channel_) | ADC_INPUTCTRL_INPUTSCAN(span_ - 1);
+    AdcInput::SyncBusy();
+
+    // Free-running, each conversion moves on to the next channel by itself
+    ADC->CTRLB.reg |= ADC_CTRLB_FREERUN;
+    AdcInput::SyncBusy();
+
+    ADC->INTFLAG.reg = ADC_INTFLAG_RESRDY | ADC_INTFLAG_OVERRUN;
+    ADC->SWTRIG.bit.START = 1;
+    AdcInput::SyncBusy();
+}
+
+void AdcScanGroup::EndSweep()
+{
+    ADC->CTRLB.reg &= ~ADC_CTRLB_FREERUN;
+    AdcInput::SyncBusy();
+
+    // Drop the conversion of the next sweep already started
+    ADC->SWTRIG.bit.FLUSH = 1;
+    AdcInput::SyncBusy();
+
+    ADC->INPUTCTRL.reg &= ~(ADC_INPUTCTRL_INPUTSCAN_Msk | ADC_INPUTCTRL_INPUTOFFSET_Msk);
+    AdcInput::SyncBusy();
+    ADC->INTFLAG.reg = ADC_INTFLAG_RESRDY | ADC_INTFLAG_OVERRUN;
+}
+
+void AdcScanGroup::OnScanDone()
+{
+    EndSweep();
+    busy_ = false;
+    done_();
+}
+
+}
@@ -0,0 +1,184 @@
+#include "minisamd21/Dma.hpp"
+
+namespace minisamd21
+{
+
+// Bus address of a buffer or descriptor
+static uint32_t Address(const volatile void *pointer)
+{
+    return static_cast<uint32_t>(reinterpret_cast<uintptr_t>(pointer));
+}
+
+void Dma::Init()
+{
+    if (initialized_)
+    {
+        return;
+    }
+
+    PM->AHBMASK.reg |= PM_AHBMASK_DMAC;
+    PM->APBBMASK.reg |= PM_APBBMASK_DMAC;
+
+    DMAC->CTRL.reg = 0;
+    DMAC->CTRL.reg = DMAC_CTRL_SWRST;
+    while (DMAC->CTRL.reg & DMAC_CTRL_SWRST)
+        ;
+
+    DMAC->BASEADDR.reg = Address(descriptors_);
+    DMAC->WRBADDR.reg = Address(writeback_);
+    DMAC->CTRL.reg = DMAC_CTRL_DMAENABLE | DMAC_CTRL_LVLEN(0xF);
+
+    NVIC_SetPriority(DMAC_IRQn, 1);
+    NVIC_EnableIRQ(DMAC_IRQn);
+
+    initialized_ = true;
+}
+
+uint8_t Dma::Acquire(uint8_t trigger, TriggerAction action, uint8_t priority)
+{
+    Init();
+
+    uint8_t channel = 0;
+    while (channel < DMAC_CH_NUM && (used_channels_ & (1 << channel)))
+    {
+        channel++;
+    }
+    if (channel == DMAC_CH_NUM)
+    {
+        return NONE;
+    }
+    used_channels_ |= 1 << channel;
+
+    // CHID selects the channel the CH* registers refer to
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    DMAC->CHID.reg = DMAC_CHID_ID(channel);
+    DMAC->CHCTRLA.reg = 0;
+    DMAC->CHCTRLA.reg = DMAC_CHCTRLA_SWRST;
+    while (DMAC->CHCTRLA.reg & DMAC_CHCTRLA_SWRST)
+        ;
+    DMAC->CHCTRLB.reg = DMAC_CHCTRLB_LVL(priority) |
+                        DMAC_CHCTRLB_TRIGSRC(trigger) |
+                        DMAC_CHCTRLB_TRIGACT(static_cast<uint8_t>(action));
+
+    __set_PRIMASK(primask);
+
+    descriptors_[channel].BTCTRL.reg = 0;
+    return channel;
+}
+
+void Dma::Release(uint8_t channel)
+{
+    if (channel >= DMAC_CH_NUM || !(used_channels_ & (1 << channel)))
+    {
+        return;
+    }
+
+    Disable(channel);
+    callbacks_[channel] = nullptr;
+    used_channels_ &= ~(1 << channel);
+}
+
+void Dma::SetTransfer(DmacDescriptor &descriptor, const volatile void *source, bool source_increment,
+                      volatile void *destination, bool destination_increment, uint16_t count,
+                      BeatSize size, bool interrupt, DmacDescriptor *next)
+{
+    uint32_t bytes = static_cast<uint32_t>(count) << static_cast<uint8_t>(size);
+
+    // Incrementing addresses point to the end of the block
+    uint32_t source_address = Address(source);
+    uint32_t destination_address = Address(destination);
+    if (source_increment)
+    {
+        source_address += bytes;
+    }
+    if (destination_increment)
+    {
+        destination_address += bytes;
+    }
+
+    descriptor.BTCNT.reg = count;
+    descriptor.SRCADDR.reg = source_address;
+    descriptor.DSTADDR.reg = destination_address;
+    descriptor.DESCADDR.reg = Address(next);
+    descriptor.BTCTRL.reg = DMAC_BTCTRL_VALID |
+                            DMAC_BTCTRL_BEATSIZE(static_cast<uint8_t>(size)) |
+                            (source_increment ? DMAC_BTCTRL_SRCINC : 0) |
+                            (destination_increment ? DMAC_BTCTRL_DSTINC : 0) |
+                            (interrupt ? DMAC_BTCTRL_BLOCKACT_INT : DMAC_BTCTRL_BLOCKACT_NOACT);
+}
+
+void Dma::Enable(uint8_t channel)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    DMAC->CHID.reg = DMAC_CHID_ID(channel);
+    DMAC->CHINTFLAG.reg = DMAC_CHINTFLAG_MASK;
+    DMAC->CHCTRLA.reg = DMAC_CHCTRLA_ENABLE;
+
+    __set_PRIMASK(primask);
+}
+
+void Dma::Disable(uint8_t channel)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    DMAC->CHID.reg = DMAC_CHID_ID(channel);
+    DMAC->CHCTRLA.reg = 0;
+    while (DMAC->CHCTRLA.reg & DMAC_CHCTRLA_ENABLE)
+        ;
+
+    __set_PRIMASK(primask);
+}
+
+bool Dma::IsNext(uint8_t channel, const DmacDescriptor &descriptor)
+{
+    return writeback_[channel].DESCADDR.reg == Address(&descriptor);
+}
+
+void Dma::SetCallback(uint8_t channel, Callback callback)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    callbacks_[channel] = callback;
+    DMAC->CHID.reg = DMAC_CHID_ID(channel);
+    if (callback)
+    {
+        DMAC->CHINTENSET.reg = DMAC_CHINTENSET_TCMPL;
+    }
+    else
+    {
+        DMAC->CHINTENCLR.reg = DMAC_CHINTENCLR_TCMPL;
+    }
+
+    __set_PRIMASK(primask);
+}
+
+void Dma::InterruptHandler()
+{
+    // INTPEND shows the lowest channel with a pending interrupt
+    while (DMAC->INTSTATUS.reg)
+    {
+        uint16_t pending = DMAC->INTPEND.reg;
+        uint8_t channel = pending & DMAC_INTPEND_ID_Msk;
+
+        // Writing the flags back clears them for that channel
+        DMAC->INTPEND.reg = pending & (DMAC_INTPEND_ID_Msk | DMAC_INTPEND_TCMPL | DMAC_INTPEND_TERR | DMAC_INTPEND_SUSP);
+
+        if (pending & DMAC_INTPEND_TCMPL)
+        {
+            callbacks_[channel]();
+        }
+    }
+}
+
+}
+
+extern "C" void DMAC_Handler()
+{
+    minisamd21::Dma::InterruptHandler();
+}
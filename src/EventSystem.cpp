@@ -0,0 +1,71 @@
+#include "minisamd21/EventSystem.hpp"
+#include "minisamd21/GenericClock.hpp"
+
+namespace minisamd21
+{
+
+void EventSystem::Init()
+{
+    PM->APBCMASK.reg |= PM_APBCMASK_EVSYS;
+}
+
+uint8_t EventSystem::Acquire(uint8_t generator, Path path, Edge edge)
+{
+    Init();
+
+    uint8_t channel = 0;
+    while (channel < EVSYS_CHANNELS && (used_channels_ & (1 << channel)))
+    {
+        channel++;
+    }
+    if (channel == EVSYS_CHANNELS)
+    {
+        return NONE;
+    }
+    used_channels_ |= 1 << channel;
+
+    if (path == Path::ASYNCHRONOUS)
+    {
+        edge = Edge::NONE; // Must be 0 on the asynchronous path
+    }
+    else
+    {
+        GenericClock::Connect(GCLK_CLKCTRL_ID_EVSYS_0_Val + channel, GenericClock::MAIN);
+    }
+
+    // Single write, the channel is selected by the CHANNEL field
+    EVSYS->CHANNEL.reg = EVSYS_CHANNEL_CHANNEL(channel) |
+                         EVSYS_CHANNEL_EVGEN(generator) |
+                         EVSYS_CHANNEL_PATH(static_cast<uint8_t>(path)) |
+                         EVSYS_CHANNEL_EDGSEL(static_cast<uint8_t>(edge));
+    return channel;
+}
+
+void EventSystem::Release(uint8_t channel)
+{
+    if (channel >= EVSYS_CHANNELS || !(used_channels_ & (1 << channel)))
+    {
+        return;
+    }
+
+    // No generator, the channel is off
+    EVSYS->CHANNEL.reg = EVSYS_CHANNEL_CHANNEL(channel);
+    GenericClock::Disconnect(GCLK_CLKCTRL_ID_EVSYS_0_Val + channel);
+
+    used_channels_ &= ~(1 << channel);
+}
+
+void EventSystem::Connect(uint8_t channel, uint8_t user)
+{
+    Init();
+
+    // CHANNEL holds the channel number plus one, 0 is no channel
+    EVSYS->USER.reg = EVSYS_USER_USER(user) | EVSYS_USER_CHANNEL(channel + 1);
+}
+
+void EventSystem::Disconnect(uint8_t user)
+{
+    EVSYS->USER.reg = EVSYS_USER_USER(user);
+}
+
+}
@@ -0,0 +1,139 @@
+#include "minisamd21/Executor.hpp"
+#include "minisamd21/AdcInput.hpp"
+#include "minisamd21/I2C.hpp"
+#include "minisamd21/Pin.hpp"
+#include "minisamd21/System.hpp"
+#include "samd21.h"
+
+namespace minisamd21
+{
+
+void Executor::Schedule(std::coroutine_handle<> handle)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (ready_count_ >= MAX_READY)
+    {
+        while (1)
+        {
+            // fail, ready queue overflow (raise MAX_READY)
+        }
+    }
+
+    ready_[(ready_head_ + ready_count_) & (MAX_READY - 1)] = handle.address();
+    ready_count_ = ready_count_ + 1;
+
+    __set_PRIMASK(primask);
+}
+
+void Executor::Run()
+{
+    System::ProcessTimers();
+    Pin::ProcessEvents();
+
+    // Only resume what is ready now, a coroutine scheduling itself again runs on the next call
+    uint8_t count = ready_count_;
+    while (count--)
+    {
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+
+        void *address = ready_[ready_head_];
+        ready_head_ = (ready_head_ + 1) & (MAX_READY - 1);
+        ready_count_ = ready_count_ - 1;
+
+        __set_PRIMASK(primask);
+
+        std::coroutine_handle<>::from_address(address).resume();
+    }
+}
+
+bool Executor::IsIdle()
+{
+    // Standby stops the clock of the ADC and the SERCOMs, their completions would never come
+    return ready_count_ == 0 && !Pin::HasEvents() && !AdcInput::HasPendingReads() && !I2C::HasPendingTransfers();
+}
+
+void *Executor::Allocate(size_t size)
+{
+    if (!arena_initialized_)
+    {
+        free_list_ = reinterpret_cast<Block *>(arena_);
+        free_list_->size = ARENA_SIZE;
+        free_list_->next = nullptr;
+        arena_initialized_ = true;
+    }
+
+    // Header plus frame, rounded up to keep every block aligned
+    size_t needed = (size + sizeof(Block) + BLOCK_ALIGN - 1) & ~(BLOCK_ALIGN - 1);
+
+    // First fit
+    Block **link = &free_list_;
+    while (*link != nullptr && (*link)->size < needed)
+    {
+        link = &(*link)->next;
+    }
+    Block *block = *link;
+    if (block == nullptr)
+    {
+        return nullptr; // Arena exhausted
+    }
+
+    if (block->size - needed >= 2 * sizeof(Block))
+    {
+        // Split, the rest stays free
+        Block *rest = reinterpret_cast<Block *>(reinterpret_cast<uint8_t *>(block) + needed);
+        rest->size = block->size - needed;
+        rest->next = block->next;
+        block->size = needed;
+        *link = rest;
+    }
+    else
+    {
+        *link = block->next;
+    }
+
+    return block + 1;
+}
+
+void Executor::Free(void *pointer)
+{
+    if (pointer == nullptr)
+    {
+        return;
+    }
+    Block *block = static_cast<Block *>(pointer) - 1;
+
+    // Keep the free list sorted by address so neighbours can be merged
+    Block *prev = nullptr;
+    Block *next = free_list_;
+    while (next != nullptr && next < block)
+    {
+        prev = next;
+        next = next->next;
+    }
+
+    block->next = next;
+    if (next != nullptr && reinterpret_cast<uint8_t *>(block) + block->size == reinterpret_cast<uint8_t *>(next))
+    {
+        block->size += next->size;
+        block->next = next->next;
+    }
+
+    if (prev != nullptr)
+    {
+        prev->next = block;
+        if (reinterpret_cast<uint8_t *>(prev) + prev->size == reinterpret_cast<uint8_t *>(block))
+        {
+            prev->size += block->size;
+            prev->next = block->next;
+        }
+    }
+    else
+    {
+        free_list_ = block;
+    }
+}
+
+}
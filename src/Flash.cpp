@@ -0,0 +1,94 @@
+#include "minisamd21/Flash.hpp"
+
+// Start of the row reserved by the linker script
+extern "C" uint32_t _ssettings;
+
+namespace minisamd21
+{
+
+bool Flash::EraseRow(uint32_t address)
+{
+    if (address % ROW_SIZE)
+    {
+        return false;
+    }
+    return Command(NVMCTRL_CTRLA_CMD_ER, address);
+}
+
+bool Flash::Write(uint32_t address, const void *data, uint32_t size)
+{
+    if (address % PAGE_SIZE)
+    {
+        return false;
+    }
+
+    // Only 32-bit writes reach the page buffer
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    volatile uint32_t *destination = reinterpret_cast<volatile uint32_t *>(address);
+
+    // Manual page writes, the page buffer is committed by the WP command
+    NVMCTRL->CTRLB.reg |= NVMCTRL_CTRLB_MANW;
+
+    uint32_t offset = 0;
+    while (offset < size)
+    {
+        uint32_t page = address + offset;
+        if (!Command(NVMCTRL_CTRLA_CMD_PBC, page))
+        {
+            return false;
+        }
+
+        uint32_t page_end = offset + PAGE_SIZE;
+        for (; offset < size && offset < page_end; offset += 4)
+        {
+            // Unused bytes of the last word stay erased
+            uint32_t word = 0xFFFFFFFF;
+            for (uint8_t i = 0; i < 4 && offset + i < size; ++i)
+            {
+                word = (word & ~(0xFFUL << (i * 8))) | (static_cast<uint32_t>(bytes[offset + i]) << (i * 8));
+            }
+            destination[offset / 4] = word;
+        }
+
+        if (!Command(NVMCTRL_CTRLA_CMD_WP, page))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+const void *Flash::GetSettings()
+{
+    return &_ssettings;
+}
+
+bool Flash::WriteSettings(const void *data, uint32_t size)
+{
+    uint32_t address = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(&_ssettings));
+    if (size > ROW_SIZE)
+    {
+        return false;
+    }
+    return EraseRow(address) && Write(address, data, size);
+}
+
+bool Flash::Command(uint32_t command, uint32_t address)
+{
+    while (!(NVMCTRL->INTFLAG.reg & NVMCTRL_INTFLAG_READY))
+        ;
+
+    // Clear the errors of earlier commands
+    NVMCTRL->STATUS.reg = NVMCTRL_STATUS_MASK;
+
+    // ADDR counts 16-bit words
+    NVMCTRL->ADDR.reg = address / 2;
+    NVMCTRL->CTRLA.reg = command | NVMCTRL_CTRLA_CMDEX_KEY;
+
+    while (!(NVMCTRL->INTFLAG.reg & NVMCTRL_INTFLAG_READY))
+        ;
+
+    return !(NVMCTRL->STATUS.reg & (NVMCTRL_STATUS_PROGE | NVMCTRL_STATUS_LOCKE | NVMCTRL_STATUS_NVME));
+}
+
+}
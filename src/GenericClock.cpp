@@ -0,0 +1,135 @@
+#include "minisamd21/GenericClock.hpp"
+
+namespace minisamd21
+{
+
+uint32_t GenericClock::MaxDivider(uint8_t generator)
+{
+    switch (generator)
+    {
+    case 1:
+        return 0xFFFF; // 16-bit divider
+    case 2:
+        return 0x1F; // 5-bit divider
+    default:
+        return 0xFF; // 8-bit divider
+    }
+}
+
+uint8_t GenericClock::Acquire(Source source, uint32_t divider, bool run_standby)
+{
+    if (divider == 0)
+    {
+        divider = 1;
+    }
+
+    // Share a generator that is already running with the same setup
+    for (uint8_t i = 1; i < GCLK_GEN_NUM; ++i)
+    {
+        Generator &gen = generators_[i];
+        if (gen.references > 0 && gen.source == source && gen.divider == divider && gen.run_standby == run_standby)
+        {
+            gen.references++;
+            return i;
+        }
+    }
+
+    // Pick a free generator, keep 2 and 1 (wider dividers) for when the others are taken
+    static constexpr uint8_t ORDER[] = {3, 4, 5, 6, 7, 8, 2, 1};
+    for (uint8_t i : ORDER)
+    {
+        Generator &gen = generators_[i];
+        if (gen.references > 0 || divider > MaxDivider(i))
+        {
+            continue;
+        }
+
+        GCLK->GENDIV.reg = GCLK_GENDIV_ID(i) | GCLK_GENDIV_DIV(divider);
+        SyncBusy();
+
+        GCLK->GENCTRL.reg = GCLK_GENCTRL_ID(i) |
+                            GCLK_GENCTRL_SRC(static_cast<uint8_t>(source)) |
+                            GCLK_GENCTRL_IDC |
+                            (run_standby ? GCLK_GENCTRL_RUNSTDBY : 0) |
+                            GCLK_GENCTRL_GENEN;
+        SyncBusy();
+
+        gen.source = source;
+        gen.divider = divider;
+        gen.run_standby = run_standby;
+        gen.references = 1;
+        return i;
+    }
+
+    return NONE;
+}
+
+void GenericClock::Release(uint8_t generator)
+{
+    if (generator == MAIN || generator >= GCLK_GEN_NUM)
+    {
+        return;
+    }
+
+    Generator &gen = generators_[generator];
+    if (gen.references == 0)
+    {
+        return;
+    }
+
+    gen.references--;
+    if (gen.references == 0)
+    {
+        // Nobody uses it anymore, stop it to save power
+        GCLK->GENCTRL.reg = GCLK_GENCTRL_ID(generator);
+        SyncBusy();
+    }
+}
+
+void GenericClock::Connect(uint8_t channel, uint8_t generator)
+{
+    if (channel >= GCLK_NUM || generator >= GCLK_GEN_NUM)
+    {
+        return;
+    }
+
+    // Already routed, nothing to write or wait for
+    if (channels_[channel] == generator + 1)
+    {
+        return;
+    }
+
+    // The generator of an enabled channel must not change, stop the clock first
+    if (channels_[channel] != 0)
+    {
+        Disconnect(channel);
+    }
+
+    GCLK->CLKCTRL.reg = GCLK_CLKCTRL_ID(channel) |
+                        GCLK_CLKCTRL_GEN(generator) |
+                        GCLK_CLKCTRL_CLKEN;
+    SyncBusy();
+
+    channels_[channel] = generator + 1;
+}
+
+void GenericClock::Disconnect(uint8_t channel)
+{
+    if (channel >= GCLK_NUM)
+    {
+        return;
+    }
+
+    // Write the channel with CLKEN cleared
+    GCLK->CLKCTRL.reg = GCLK_CLKCTRL_ID(channel);
+
+    // Select the channel for reading (8-bit write to ID) until the clock has stopped
+    do
+    {
+        *reinterpret_cast<volatile uint8_t *>(&GCLK->CLKCTRL.reg) = channel;
+    } while (GCLK->CLKCTRL.reg & GCLK_CLKCTRL_CLKEN);
+
+    channels_[channel] = 0;
+}
+
+}
@@ -1,4 +1,7 @@
 #include "minisamd21/I2C.hpp"
+#include "minisamd21/Executor.hpp"
+#include "minisamd21/GenericClock.hpp"
+#include "minisamd21/System.hpp"
 
 namespace minisamd21
 {
@@ -10,9 +13,11 @@ I2C::I2C(Interface iface)
     {
     case Interface::TWI0:
         sercom_ = SERCOM0;
+        index_ = 0;
         break;
     case Interface::TWI1:
         sercom_ = SERCOM1;
+        index_ = 1;
         break;
     default:
         sercom_ = nullptr;
@@ -21,23 +26,75 @@ I2C::I2C(Interface iface)
     EnablePeripheral();
 }
 
+I2C::~I2C()
+{
+    System::UnsubscribeClockChange(OnClockChange, this);
+    if (instances_[index_] == this)
+    {
+        instances_[index_] = nullptr;
+    }
+}
+
 void I2C::Init(uint32_t baud)
 {
+    baud_ = baud;
+
     // Init
     sercom_->I2CM.CTRLA.reg = SERCOM_I2CM_CTRLA_MODE(0x5) |
                               SERCOM_I2CM_CTRLA_SDAHOLD(0x3) |
                               SERCOM_I2CM_CTRLA_SPEED(0x1);
 
-    sercom_->I2CM.BAUD.reg = (uint16_t)((48000000 / (2 * baud)) - 1);
+    SetBaud(System::GetFrequency());
+    Enable();
+
+    // Keep the bus speed when the core clock changes
+    System::SubscribeClockChange(OnClockChange, this);
+
+    // Interrupts are only enabled while asynchronous transfers are queued
+    instances_[index_] = this;
+    IRQn_Type irq = index_ == 0 ? SERCOM0_IRQn : SERCOM1_IRQn;
+    NVIC_SetPriority(irq, 1);
+    NVIC_EnableIRQ(irq);
+}
+
+void I2C::SetBaud(uint32_t frequency)
+{
+    sercom_->I2CM.BAUD.reg = (uint16_t)((frequency / (2 * baud_)) - 1);
+}
 
+void I2C::Enable()
+{
     sercom_->I2CM.CTRLA.reg |= SERCOM_I2CM_CTRLA_ENABLE;
     while (sercom_->I2CM.SYNCBUSY.reg)
     {
     }
 }
 
+void I2C::OnClockChange(void *context, uint32_t frequency)
+{
+    I2C *i2c = static_cast<I2C *>(context);
+    Sercom *sercom = i2c->sercom_;
+
+    // BAUD is enable-protected
+    sercom->I2CM.CTRLA.reg &= ~SERCOM_I2CM_CTRLA_ENABLE;
+    while (sercom->I2CM.SYNCBUSY.reg)
+    {
+    }
+
+    i2c->SetBaud(frequency);
+    i2c->Enable();
+
+    // Bus state is unknown after re-enabling, force it to idle
+    sercom->I2CM.STATUS.reg = SERCOM_I2CM_STATUS_BUSSTATE(1);
+    while (sercom->I2CM.SYNCBUSY.reg)
+    {
+    }
+}
+
 void I2C::DeInit()
 {
+    System::UnsubscribeClockChange(OnClockChange, this);
+
     // Disable the I2C interface
     sercom_->I2CM.CTRLA.reg &= ~SERCOM_I2CM_CTRLA_ENABLE;
     while (sercom_->I2CM.SYNCBUSY.reg)
@@ -53,6 +110,11 @@ void I2C::DeInit()
 
 void I2C::Write(uint8_t address, uint8_t *data, uint32_t length, bool nostop)
 {
+    // Let queued asynchronous transfers finish first
+    while (transfer_head_ != nullptr)
+    {
+    }
+
     // First, check bus status and clear any error conditions
     if (sercom_->I2CM.STATUS.reg & SERCOM_I2CM_STATUS_BUSERR)
     {
@@ -120,6 +182,11 @@ void I2C::Write(uint8_t address, uint8_t *data, uint32_t length, bool nostop)
 
 void I2C::Read(uint8_t address, uint8_t *data, uint32_t length)
 {
+    // Let queued asynchronous transfers finish first
+    while (transfer_head_ != nullptr)
+    {
+    }
+
     // First, check bus status and clear any error conditions
     if (sercom_->I2CM.STATUS.reg & SERCOM_I2CM_STATUS_BUSERR)
     {
@@ -221,6 +288,186 @@ void I2C::ReadRegisters(uint16_t address, uint16_t register_address, uint8_t reg
     Read(address, data, length);
 }
 
+void I2C::TransferAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    done_ = [handle]
+    {
+        Executor::Schedule(handle);
+    };
+    next_ = nullptr;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (i2c_.transfer_head_ == nullptr)
+    {
+        i2c_.transfer_head_ = this;
+        i2c_.transfer_tail_ = this;
+        i2c_.StartTransfer(*this);
+    }
+    else
+    {
+        i2c_.transfer_tail_->next_ = this;
+        i2c_.transfer_tail_ = this;
+    }
+
+    __set_PRIMASK(primask);
+}
+
+void I2C::StartTransfer(TransferAwaiter &transfer)
+{
+    // Clear a previous bus error and make sure the bus is idle
+    if (sercom_->I2CM.STATUS.reg & SERCOM_I2CM_STATUS_BUSERR)
+    {
+        sercom_->I2CM.STATUS.reg = SERCOM_I2CM_STATUS_BUSERR;
+    }
+    if ((sercom_->I2CM.STATUS.reg & SERCOM_I2CM_STATUS_BUSSTATE_Msk) == SERCOM_I2CM_STATUS_BUSSTATE(0))
+    {
+        sercom_->I2CM.STATUS.reg = SERCOM_I2CM_STATUS_BUSSTATE(1);
+        while (sercom_->I2CM.SYNCBUSY.bit.SYSOP)
+        {
+        }
+    }
+
+    transfer_index_ = 0;
+    transfer_reading_ = transfer.write_length_ == 0 && transfer.read_length_ > 0;
+
+    sercom_->I2CM.INTFLAG.reg = SERCOM_I2CM_INTFLAG_ERROR;
+    sercom_->I2CM.INTENSET.reg = SERCOM_I2CM_INTENSET_MB | SERCOM_I2CM_INTENSET_SB | SERCOM_I2CM_INTENSET_ERROR;
+
+    // Writing the address sends START, MB or SB fires once it is (n)acked
+    sercom_->I2CM.CTRLB.reg &= ~SERCOM_I2CM_CTRLB_ACKACT;
+    while (sercom_->I2CM.SYNCBUSY.bit.SYSOP)
+    {
+    }
+    sercom_->I2CM.ADDR.reg = (transfer.address_ << 1) | (transfer_reading_ ? 0x01 : 0x00);
+}
+
+void I2C::FinishTransfer(bool result)
+{
+    TransferAwaiter *done = transfer_head_;
+    done->result_ = result;
+
+    // Start the next queued transfer right away
+    transfer_head_ = done->next_;
+    if (transfer_head_ != nullptr)
+    {
+        StartTransfer(*transfer_head_);
+    }
+    else
+    {
+        transfer_tail_ = nullptr;
+        sercom_->I2CM.INTENCLR.reg = SERCOM_I2CM_INTENCLR_MB | SERCOM_I2CM_INTENCLR_SB | SERCOM_I2CM_INTENCLR_ERROR;
+    }
+
+    done->done_();
+}
+
+void I2C::SendCommand(uint32_t command, bool nack)
+{
+    uint32_t ctrlb = sercom_->I2CM.CTRLB.reg & ~(SERCOM_I2CM_CTRLB_CMD_Msk | SERCOM_I2CM_CTRLB_ACKACT);
+    sercom_->I2CM.CTRLB.reg = ctrlb | SERCOM_I2CM_CTRLB_CMD(command) | (nack ? SERCOM_I2CM_CTRLB_ACKACT : 0);
+    while (sercom_->I2CM.SYNCBUSY.bit.SYSOP)
+    {
+    }
+}
+
+void I2C::HandleInterrupt()
+{
+    TransferAwaiter *transfer = transfer_head_;
+    uint8_t flags = sercom_->I2CM.INTFLAG.reg;
+    uint16_t status = sercom_->I2CM.STATUS.reg;
+
+    if (transfer == nullptr)
+    {
+        sercom_->I2CM.INTENCLR.reg = SERCOM_I2CM_INTENCLR_MB | SERCOM_I2CM_INTENCLR_SB | SERCOM_I2CM_INTENCLR_ERROR;
+        return;
+    }
+
+    // Bus error or lost arbitration, the bus is not ours anymore
+    if ((flags & SERCOM_I2CM_INTFLAG_ERROR) || (status & (SERCOM_I2CM_STATUS_BUSERR | SERCOM_I2CM_STATUS_ARBLOST)))
+    {
+        sercom_->I2CM.INTFLAG.reg = SERCOM_I2CM_INTFLAG_ERROR;
+        sercom_->I2CM.STATUS.reg = SERCOM_I2CM_STATUS_BUSERR | SERCOM_I2CM_STATUS_ARBLOST;
+        SendCommand(0x3); // STOP, also clears MB/SB
+        FinishTransfer(false);
+        return;
+    }
+
+    if (flags & SERCOM_I2CM_INTFLAG_MB)
+    {
+        // Address or data not acknowledged (MB is also how a NACKed read address ends)
+        if ((status & SERCOM_I2CM_STATUS_RXNACK) || transfer_reading_)
+        {
+            SendCommand(0x3); // STOP
+            FinishTransfer(false);
+            return;
+        }
+
+        if (transfer_index_ < transfer->write_length_)
+        {
+            sercom_->I2CM.DATA.reg = transfer->write_data_[transfer_index_++];
+            return;
+        }
+
+        if (transfer->read_length_ > 0)
+        {
+            // Repeated start with the read address
+            transfer_reading_ = true;
+            transfer_index_ = 0;
+            sercom_->I2CM.ADDR.reg = (transfer->address_ << 1) | 0x01;
+            return;
+        }
+
+        SendCommand(0x3); // STOP
+        FinishTransfer(true);
+        return;
+    }
+
+    if (flags & SERCOM_I2CM_INTFLAG_SB)
+    {
+        bool last = transfer_index_ + 1 >= transfer->read_length_;
+        transfer->read_data_[transfer_index_++] = sercom_->I2CM.DATA.reg;
+
+        if (last)
+        {
+            SendCommand(0x3, true); // NACK the last byte, then STOP
+            FinishTransfer(true);
+        }
+        else
+        {
+            SendCommand(0x2); // ACK and read the next byte
+        }
+    }
+}
+
+bool I2C::HasPendingTransfers()
+{
+    for (I2C *i2c : instances_)
+    {
+        if (i2c != nullptr && i2c->transfer_head_ != nullptr)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void I2C::InterruptHandler(uint8_t index)
+{
+    I2C *i2c = instances_[index];
+    if (i2c != nullptr)
+    {
+        i2c->HandleInterrupt();
+    }
+    else
+    {
+        // Nobody to serve, keep the interrupt quiet
+        Sercom *sercom = index == 0 ? SERCOM0 : SERCOM1;
+        sercom->I2CM.INTENCLR.reg = SERCOM_I2CM_INTENCLR_MASK;
+    }
+}
+
 void I2C::EnablePeripheral()
 {
     if (sercom_ == SERCOM0)
@@ -229,14 +476,7 @@ void I2C::EnablePeripheral()
         PM->APBCMASK.reg |= PM_APBCMASK_SERCOM0;
 
         // Set up GCLK for SERCOM0
-        GCLK->CLKCTRL.reg = GCLK_CLKCTRL_ID(GCLK_CLKCTRL_ID_SERCOM0_CORE_Val) |
-                            GCLK_CLKCTRL_GEN_GCLK0 |
-                            GCLK_CLKCTRL_CLKEN;
-
-        // Wait for synchronization
-        while (GCLK->STATUS.bit.SYNCBUSY)
-        {
-        }
+        GenericClock::Connect(GCLK_CLKCTRL_ID_SERCOM0_CORE_Val, GenericClock::MAIN);
 
         // Configure pins
         PORT->Group[0].PINCFG[8].reg |= PORT_PINCFG_PMUXEN;
@@ -250,14 +490,7 @@ void I2C::EnablePeripheral()
         PM->APBCMASK.reg |= PM_APBCMASK_SERCOM1;
 
         // Set up GCLK for SERCOM1
-        GCLK->CLKCTRL.reg = GCLK_CLKCTRL_ID(GCLK_CLKCTRL_ID_SERCOM1_CORE_Val) |
-                            GCLK_CLKCTRL_GEN_GCLK0 |
-                            GCLK_CLKCTRL_CLKEN;
-
-        // Wait for synchronization
-        while (GCLK->STATUS.bit.SYNCBUSY)
-        {
-        }
+        GenericClock::Connect(GCLK_CLKCTRL_ID_SERCOM1_CORE_Val, GenericClock::MAIN);
 
         // Configure pins
         PORT->Group[0].PINCFG[22].reg |= PORT_PINCFG_PMUXEN;
@@ -274,3 +507,13 @@ void I2C::EnablePeripheral()
 }
 
 } // namespace minisamd21
+
+extern "C" void SERCOM0_Handler(void)
+{
+    minisamd21::I2C::InterruptHandler(0);
+}
+
+extern "C" void SERCOM1_Handler(void)
+{
+    minisamd21::I2C::InterruptHandler(1);
+}
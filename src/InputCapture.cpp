@@ -0,0 +1,170 @@
+#include "minisamd21/InputCapture.hpp"
+#include "minisamd21/PwmOutput.hpp"
+#include "minisamd21/System.hpp"
+
+namespace minisamd21
+{
+
+bool InputCapture::Init(uint8_t average)
+{
+    if (in_use_ || average == 0 || average > MAX_AVERAGE)
+    {
+        return false;
+    }
+
+    // A PWM output on TC4 or TC5 would be reprogrammed under it
+    if (PwmOutput::IsTimerEnabled(4) || PwmOutput::IsTimerEnabled(5))
+    {
+        return false;
+    }
+
+    event_channel_ = pin_.RouteToEvent(Pin::InterruptMode::HIGH);
+    if (event_channel_ == EventSystem::NONE)
+    {
+        return false;
+    }
+
+    dma_channel_ = Dma::Acquire(TC4_DMAC_ID_MC_0, Dma::TriggerAction::BLOCK);
+    if (dma_channel_ == Dma::NONE)
+    {
+        pin_.UnrouteEvent(event_channel_);
+        event_channel_ = EventSystem::NONE;
+        return false;
+    }
+
+    // The counter runs from the DFLL, independent of the core clock
+    generator_ = GenericClock::Acquire(GenericClock::Source::DFLL48M);
+    if (generator_ == GenericClock::NONE)
+    {
+        Dma::Release(dma_channel_);
+        dma_channel_ = Dma::NONE;
+        pin_.UnrouteEvent(event_channel_);
+        event_channel_ = EventSystem::NONE;
+        return false;
+    }
+
+    in_use_ = true;
+    average_ = average;
+    for (volatile Sample &sample : samples_)
+    {
+        sample.period = 0;
+        sample.pulse_width = 0;
+    }
+
+    // One block of CC0 and CC1 per period. The first capture only covers part of a
+    // period and goes aside, the next ones to a ring over the samples.
+    Dma::SetTransfer(Dma::GetDescriptor(dma_channel_), &TC4->COUNT32.CC[0].reg, true, &discarded_, true, 2,
+                     Dma::BeatSize::WORD, false, &descriptors_[0]);
+    for (uint8_t i = 0; i < average_; ++i)
+    {
+        DmacDescriptor *next = &descriptors_[i + 1 < average_ ? i + 1 : 0];
+        Dma::SetTransfer(descriptors_[i], &TC4->COUNT32.CC[0].reg, true, &samples_[i], true, 2,
+                         Dma::BeatSize::WORD, false, next);
+    }
+
+    GenericClock::Connect(GCLK_CLKCTRL_ID_TC4_TC5_Val, generator_);
+    PM->APBCMASK.reg |= PM_APBCMASK_TC4 | PM_APBCMASK_TC5;
+
+    TC4->COUNT32.CTRLA.reg = TC_CTRLA_SWRST;
+    while (TC4->COUNT32.CTRLA.reg & TC_CTRLA_SWRST)
+        ;
+
+    // TC5 becomes the upper half of the counter
+    TC4->COUNT32.CTRLA.reg = TC_CTRLA_MODE_COUNT32 | TC_CTRLA_PRESCALER_DIV1;
+    SyncTC();
+    TC4->COUNT32.CTRLC.reg = TC_CTRLC_CPTEN0 | TC_CTRLC_CPTEN1;
+    SyncTC();
+    TC4->COUNT32.EVCTRL.reg = TC_EVCTRL_EVACT_PPW | TC_EVCTRL_TCEI;
+
+    EventSystem::Connect(event_channel_, EVSYS_ID_USER_TC4_EVU);
+    Dma::Enable(dma_channel_);
+
+    TC4->COUNT32.CTRLA.reg |= TC_CTRLA_ENABLE;
+    SyncTC();
+    return true;
+}
+
+void InputCapture::DeInit()
+{
+    if (average_ == 0)
+    {
+        return;
+    }
+
+    TC4->COUNT32.CTRLA.reg &= ~TC_CTRLA_ENABLE;
+    SyncTC();
+    PM->APBCMASK.reg &= ~(PM_APBCMASK_TC4 | PM_APBCMASK_TC5);
+    GenericClock::Disconnect(GCLK_CLKCTRL_ID_TC4_TC5_Val);
+    GenericClock::Release(generator_);
+    generator_ = GenericClock::NONE;
+
+    Dma::Release(dma_channel_);
+    dma_channel_ = Dma::NONE;
+
+    EventSystem::Disconnect(EVSYS_ID_USER_TC4_EVU);
+    pin_.UnrouteEvent(event_channel_);
+    event_channel_ = EventSystem::NONE;
+
+    average_ = 0;
+    in_use_ = false;
+}
+
+bool InputCapture::Read(uint32_t &period, uint32_t &pulse_width) const
+{
+    if (average_ == 0)
+    {
+        return false;
+    }
+
+    uint64_t period_sum = 0;
+    uint64_t pulse_width_sum = 0;
+    for (uint8_t i = 0; i < average_; ++i)
+    {
+        uint32_t sample_period = samples_[i].period;
+        if (sample_period == 0)
+        {
+            return false;
+        }
+        period_sum += sample_period;
+        pulse_width_sum += samples_[i].pulse_width;
+    }
+
+    period = static_cast<uint32_t>(period_sum / average_);
+    pulse_width = static_cast<uint32_t>(pulse_width_sum / average_);
+
+    // The samples stay from the last edges, a stopped signal shows as a counter running on
+    uint32_t count = GetCount();
+    return count <= 2 * static_cast<uint64_t>(period);
+}
+
+float InputCapture::GetFrequency() const
+{
+    uint32_t period;
+    uint32_t pulse_width;
+    if (!Read(period, pulse_width))
+    {
+        return 0.0f;
+    }
+    return static_cast<float>(System::GetDfllFrequency()) / period;
+}
+
+float InputCapture::GetDutyCycle() const
+{
+    uint32_t period;
+    uint32_t pulse_width;
+    if (!Read(period, pulse_width))
+    {
+        return 0.0f;
+    }
+    return static_cast<float>(pulse_width) / period;
+}
+
+uint32_t InputCapture::GetCount()
+{
+    // COUNT has to be synchronized before it can be read
+    TC4->COUNT32.READREQ.reg = TC_READREQ_RREQ | TC_READREQ_ADDR(TC_COUNT32_COUNT_OFFSET);
+    SyncTC();
+    return TC4->COUNT32.COUNT.reg;
+}
+
+}
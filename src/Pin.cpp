@@ -1,45 +1,76 @@
 #include "minisamd21/Pin.hpp"
 #include "samd21.h"
+#include "minisamd21/EventSystem.hpp"
+#include "minisamd21/GenericClock.hpp"
+#include "minisamd21/System.hpp"
 
 namespace minisamd21
 {
 
-void Pin::Init(Mode mode)
+void Pin::Init(Mode mode, uint8_t options)
+{
+    ConfigureGroup(port_, 1UL << pin_, mode, options);
+}
+
+void Pin::ConfigureGroup(PortName port, uint32_t mask, Mode mode, uint8_t options)
 {
     // Enable the port clock if it's not already enabled
-    if (port_ == PortName::PORTA)
+    if (!(PM->APBBMASK.reg & PM_APBBMASK_PORT))
     {
-        if (!(PM->APBBMASK.reg & PM_APBBMASK_PORT))
-        {
-            PM->APBBMASK.reg |= PM_APBBMASK_PORT;
-        }
+        PM->APBBMASK.reg |= PM_APBBMASK_PORT;
     }
-    else if (port_ == PortName::PORTB)
+
+    uint8_t group = static_cast<uint8_t>(port);
+    bool input = mode != Mode::OUTPUT;
+    bool pull = mode == Mode::INPUT_PULLUP || mode == Mode::INPUT_PULLDOWN;
+
+    // OUT selects the pull direction, set it before the pull is enabled
+    if (mode == Mode::INPUT_PULLUP)
     {
-        if (!(PM->APBBMASK.reg & PM_APBBMASK_PORT))
-        {
-            PM->APBBMASK.reg |= PM_APBBMASK_PORT;
-        }
+        PORT->Group[group].OUTSET.reg = mask;
+    }
+    else if (mode == Mode::INPUT_PULLDOWN)
+    {
+        PORT->Group[group].OUTCLR.reg = mask;
     }
 
-    // Configure the pin as GPIO
-    PORT->Group[static_cast<uint8_t>(port_)].PINCFG[pin_].reg &= ~PORT_PINCFG_PMUXEN;
+    // PINCFG of all pins in mask, PMUXEN cleared so they are GPIO
+    uint32_t config = PORT_WRCONFIG_WRPINCFG;
+    if (input)
+    {
+        config |= PORT_WRCONFIG_INEN;
+    }
+    if (pull)
+    {
+        config |= PORT_WRCONFIG_PULLEN;
+    }
+    if (options & DRIVE_STRONG)
+    {
+        config |= PORT_WRCONFIG_DRVSTR;
+    }
+
+    // WRCONFIG reaches 16 pins per write, HWSEL selects the upper half
+    if (mask & 0xFFFF)
+    {
+        PORT->Group[group].WRCONFIG.reg = config | PORT_WRCONFIG_PINMASK(mask & 0xFFFF);
+    }
+    if (mask >> 16)
+    {
+        PORT->Group[group].WRCONFIG.reg = config | PORT_WRCONFIG_HWSEL | PORT_WRCONFIG_PINMASK(mask >> 16);
+    }
 
     // Set the pin direction
-    if (mode == Mode::OUTPUT)
+    if (input)
     {
-        PORT->Group[static_cast<uint8_t>(port_)].DIRSET.reg = (1 << pin_); // Set pin as output
+        PORT->Group[group].DIRCLR.reg = mask;
     }
     else
     {
-        PORT->Group[static_cast<uint8_t>(port_)].DIRCLR.reg = (1 << pin_);            // Set pin as input
-        PORT->Group[static_cast<uint8_t>(port_)].PINCFG[pin_].reg = PORT_PINCFG_INEN; // Enable input
-        if (mode == Mode::INPUT_PULLUP)
-        {
-            PORT->Group[static_cast<uint8_t>(port_)].OUTSET.reg = (1 << pin_); // Enable pull-up
-            PORT->Group[static_cast<uint8_t>(port_)].PINCFG[pin_].reg |= PORT_PINCFG_PULLEN;
-        }
+        PORT->Group[group].DIRSET.reg = mask;
     }
+
+    // Needed for IOBUS reads, outputs have their input disabled
+    SetContinuousSampling(group, mask, input && !(options & SAMPLE_ON_DEMAND));
 }
 
 void Pin::DeInit()
@@ -48,28 +79,57 @@ void Pin::DeInit()
     PORT->Group[static_cast<uint8_t>(port_)].DIRCLR.reg = (1 << pin_);              // Set pin as input
     PORT->Group[static_cast<uint8_t>(port_)].PINCFG[pin_].reg &= ~PORT_PINCFG_INEN; // Disable input
     PORT->Group[static_cast<uint8_t>(port_)].OUTCLR.reg = (1 << pin_);              // Disable pull-up
+    SetContinuousSampling(static_cast<uint8_t>(port_), 1UL << pin_, false);
 }
 
+// Read, write and toggle go through the single-cycle IOBUS mapping of PORT,
+// configuration stays on the APB
+
 bool Pin::Read() const
 {
-    return (PORT->Group[static_cast<uint8_t>(port_)].IN.reg & (1 << pin_)) != 0;
+    uint32_t mask = 1UL << pin_;
+    uint8_t group = static_cast<uint8_t>(port_);
+
+    // The IOBUS cannot wait for the on-demand resynchronization of IN
+    if (sampling_mask_[group] & mask)
+    {
+        return (PORT_IOBUS->Group[group].IN.reg & mask) != 0;
+    }
+    return (PORT->Group[group].IN.reg & mask) != 0;
 }
 
 void Pin::Write(bool value)
 {
     if (value)
     {
-        PORT->Group[static_cast<uint8_t>(port_)].OUTSET.reg = (1 << pin_);
+        PORT_IOBUS->Group[static_cast<uint8_t>(port_)].OUTSET.reg = (1 << pin_);
     }
     else
     {
-        PORT->Group[static_cast<uint8_t>(port_)].OUTCLR.reg = (1 << pin_);
+        PORT_IOBUS->Group[static_cast<uint8_t>(port_)].OUTCLR.reg = (1 << pin_);
     }
 }
 
 void Pin::Toggle()
 {
-    PORT->Group[static_cast<uint8_t>(port_)].OUTTGL.reg = (1 << pin_);
+    PORT_IOBUS->Group[static_cast<uint8_t>(port_)].OUTTGL.reg = (1 << pin_);
+}
+
+void Pin::SetContinuousSampling(uint8_t group, uint32_t mask, bool enable)
+{
+    // CTRL is write-only, keep a copy to change some pins only
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (enable)
+    {
+        sampling_mask_[group] |= mask;
+    }
+    else
+    {
+        sampling_mask_[group] &= ~mask;
+    }
+    PORT->Group[group].CTRL.reg = sampling_mask_[group];
+    __set_PRIMASK(primask);
 }
 
 uint8_t Pin::GetPin() const
@@ -92,15 +152,8 @@ void Pin::InitEIC()
     // Enable EIC clock in APBA
     PM->APBAMASK.reg |= PM_APBAMASK_EIC;
 
-    // Connect GCLK0 to EIC using the correct GCLK ID
-    GCLK->CLKCTRL.reg = GCLK_CLKCTRL_CLKEN |     // Enable GCLK
-                        GCLK_CLKCTRL_GEN_GCLK0 | // Select GCLK0
-                        GCLK_CLKCTRL_ID(5);      // Set ID for EIC (5)
-
-    // Wait for synchronization
-    while (GCLK->STATUS.bit.SYNCBUSY)
-    {
-    }
+    // Connect GCLK0 to EIC
+    GenericClock::Connect(GCLK_CLKCTRL_ID_EIC_Val, GenericClock::MAIN);
 
     // Reset EIC
     EIC->CTRL.bit.SWRST = 1;
@@ -117,13 +170,13 @@ void Pin::InitEIC()
     // Enable NVIC for EIC
     NVIC_DisableIRQ(EIC_IRQn);
     NVIC_ClearPendingIRQ(EIC_IRQn);
-    NVIC_SetPriority(EIC_IRQn, 1); // 1 = lower priority than systick (for delay to work etc)
+    NVIC_SetPriority(EIC_IRQn, 1); // 1 = lower priority than the RTC timebase
     NVIC_EnableIRQ(EIC_IRQn);
 
     eic_initialized_ = true;
 }
 
-void Pin::EnableInterrupt(InterruptMode mode)
+void Pin::ConfigureLine(InterruptMode mode, uint8_t line, bool filter)
 {
     // Initialize EIC if not already done (global static function)
     InitEIC();
@@ -142,11 +195,17 @@ void Pin::EnableInterrupt(InterruptMode mode)
     PORT->Group[static_cast<uint8_t>(port_)].PMUX[pmux_reg_pos].reg |= (0x0 << pmux_bit_pos);
 
     // Configure the sense mode in the EIC
-    uint8_t config_reg_pos = pin_ >> 3;           // Divide by 8 to get CONFIG register
-    uint8_t config_field_pos = (pin_ & 0x07) * 4; // 0, 4, 8, 12, 16, 20, 24, or 28 based on pin % 8
+    uint8_t config_reg_pos = line >> 3;           // Divide by 8 to get CONFIG register
+    uint8_t config_field_pos = (line & 0x07) * 4; // 0, 4, 8, 12, 16, 20, 24, or 28 based on line % 8
 
-    // Clear existing sense configuration
-    EIC->CONFIG[config_reg_pos].reg &= ~(0x7 << config_field_pos);
+    // Clear existing sense and filter configuration
+    EIC->CONFIG[config_reg_pos].reg &= ~(0xF << config_field_pos);
+
+    // Majority filter, an edge needs three equal samples of the EIC clock
+    if (filter)
+    {
+        EIC->CONFIG[config_reg_pos].reg |= (EIC_CONFIG_FILTEN0 << config_field_pos);
+    }
 
     // Set interrupt sense mode
     if (mode == InterruptMode::RISING)
@@ -161,6 +220,14 @@ void Pin::EnableInterrupt(InterruptMode mode)
     {
         EIC->CONFIG[config_reg_pos].reg |= (EIC_CONFIG_SENSE0_BOTH_Val << config_field_pos);
     }
+    else if (mode == InterruptMode::HIGH)
+    {
+        EIC->CONFIG[config_reg_pos].reg |= (EIC_CONFIG_SENSE0_HIGH_Val << config_field_pos);
+    }
+    else if (mode == InterruptMode::LOW)
+    {
+        EIC->CONFIG[config_reg_pos].reg |= (EIC_CONFIG_SENSE0_LOW_Val << config_field_pos);
+    }
 
     // Make sure EIC is enabled
     if (!EIC->CTRL.bit.ENABLE)
@@ -171,70 +238,279 @@ void Pin::EnableInterrupt(InterruptMode mode)
         }
     }
 
-    // Enable interrupt for this specific pin
-    EIC->INTENSET.reg = EIC_INTENSET_EXTINT(1 << pin_);
 }
 
-void Pin::AttachInterrupt(Pin::InterruptMode mode, Callback callback, bool wakeup)
+void Pin::EnableInterrupt(InterruptMode mode, uint8_t line, bool wakeup, bool filter)
 {
-    interrupt_callbacks_[pin_] = callback;
-    interrupt_attached_[pin_] = true;
+    ConfigureLine(mode, line, filter);
 
-    EnableInterrupt(mode);
+    // Enable interrupt for this line
+    EIC->INTENSET.reg = EIC_INTENSET_EXTINT(1 << line);
 
     // Enable wakeup capability if requested
     if (wakeup)
     {
-        // Sync function to wait for GCLK
-        static auto waitForSync = []()
+        // EIC needs a clock that keeps running in standby, share the 32kHz one
+        if (eic_wakeup_gclk_ == GenericClock::NONE)
         {
-            while (GCLK->STATUS.bit.SYNCBUSY)
+            eic_wakeup_gclk_ = GenericClock::Acquire(GenericClock::Source::OSCULP32K, 1, true);
+            if (eic_wakeup_gclk_ == GenericClock::NONE)
             {
+                while (1)
+                {
+                    // fail, no generator left to clock the EIC in standby
+                }
             }
-        };
+            GenericClock::Connect(GCLK_CLKCTRL_ID_EIC_Val, eic_wakeup_gclk_);
+        }
+
+        EIC->WAKEUP.reg |= (1 << line);
+    }
+}
+
+bool Pin::AttachInterrupt(Pin::InterruptMode mode, Callback callback, bool wakeup)
+{
+    uint8_t line = GetExtInt(port_, pin_);
+    if (line == EXTINT_NONE)
+    {
+        return false;
+    }
+
+    // The handler must not see a half written delegate
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    interrupt_callbacks_[line] = callback;
+    deferred_lines_ = deferred_lines_ & ~(1 << line);
+    if (debounced_lines_ & (1 << line))
+    {
+        System::StopTimer(debounce_timers_[line]);
+        debounced_lines_ = debounced_lines_ & ~(1 << line);
+    }
+    line_pins_[line] = (static_cast<uint8_t>(port_) << 5) | pin_;
+    __set_PRIMASK(primask);
+
+    EnableInterrupt(mode, line, wakeup);
+    return true;
+}
+
+bool Pin::AttachDeferredInterrupt(Pin::InterruptMode mode, EventCallback callback, bool wakeup)
+{
+    uint8_t line = GetExtInt(port_, pin_);
+    if (line == EXTINT_NONE)
+    {
+        return false;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    event_callbacks_[line] = callback;
+    deferred_lines_ = deferred_lines_ | (1 << line);
+    if (debounced_lines_ & (1 << line))
+    {
+        System::StopTimer(debounce_timers_[line]);
+        debounced_lines_ = debounced_lines_ & ~(1 << line);
+    }
+    line_pins_[line] = (static_cast<uint8_t>(port_) << 5) | pin_;
+    __set_PRIMASK(primask);
+
+    EnableInterrupt(mode, line, wakeup);
+    return true;
+}
 
-        // Configure the clock for EIC
-        GCLK->CLKCTRL.bit.CLKEN = 0;
-        waitForSync();
+bool Pin::AttachDebouncedInterrupt(Pin::InterruptMode mode, EventCallback callback, uint16_t lockout_ms, bool wakeup)
+{
+    uint8_t line = GetExtInt(port_, pin_);
+    if (line == EXTINT_NONE)
+    {
+        return false;
+    }
 
-        GCLK->CLKCTRL.reg = (uint16_t)(GCLK_CLKCTRL_CLKEN | GCLK_CLKCTRL_GEN_GCLK6 | GCLK_CLKCTRL_ID(5));
-        waitForSync();
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    event_callbacks_[line] = callback;
+    deferred_lines_ = deferred_lines_ | (1 << line);
+    line_pins_[line] = (static_cast<uint8_t>(port_) << 5) | pin_;
+    if (!(debounced_lines_ & (1 << line)))
+    {
+        // No quiet wait running, detaching stops it
+        debounce_timers_[line] = System::INVALID_TIMER;
+    }
+    debounced_lines_ = debounced_lines_ | (1 << line);
+    debounce_modes_[line] = mode;
+    lockout_ms_[line] = lockout_ms;
+    __set_PRIMASK(primask);
+
+    // Stable level the first press is told from
+    if (Read())
+    {
+        debounce_levels_ |= 1 << line;
+    }
+    else
+    {
+        debounce_levels_ &= ~(1 << line);
+    }
 
-        GCLK->GENCTRL.reg = (GCLK_GENCTRL_GENEN | GCLK_GENCTRL_SRC_OSCULP32K | GCLK_GENCTRL_ID(6));
-        waitForSync();
+    // Both edges, the release has to be seen to tell its bounces from a press
+    EnableInterrupt(InterruptMode::CHANGE, line, wakeup, true);
+    return true;
+}
 
-        GCLK->GENCTRL.bit.RUNSTDBY = 1;
-        waitForSync();
+uint8_t Pin::RouteToEvent(InterruptMode mode)
+{
+    uint8_t line = GetExtInt(port_, pin_);
+    if (line == EXTINT_NONE)
+    {
+        return EventSystem::NONE;
+    }
 
-        EIC->WAKEUP.reg |= (1 << pin_);
+    uint8_t channel = EventSystem::Acquire(EVSYS_ID_GEN_EIC_EXTINT_0 + line);
+    if (channel == EventSystem::NONE)
+    {
+        return EventSystem::NONE;
     }
+
+    ConfigureLine(mode, line, false);
+
+    // Event output only, no CPU interrupt
+    EIC->INTENCLR.reg = EIC_INTENCLR_EXTINT(1 << line);
+    EIC->EVCTRL.reg |= EIC_EVCTRL_EXTINTEO(1 << line);
+    return channel;
 }
 
-void Pin::InterruptHandler(uint8_t pinNumber)
+void Pin::UnrouteEvent(uint8_t channel)
 {
-    if (interrupt_attached_[pinNumber] && interrupt_callbacks_[pinNumber] != nullptr)
+    uint8_t line = GetExtInt(port_, pin_);
+    if (line != EXTINT_NONE)
     {
-        interrupt_callbacks_[pinNumber]();
+        EIC->EVCTRL.reg &= ~EIC_EVCTRL_EXTINTEO(1 << line);
     }
+    EventSystem::Release(channel);
+}
+
+void Pin::ProcessEvents()
+{
+    // Only what is queued now, edges arriving meanwhile wait for the next call
+    size_t count = events_.GetCount();
+    Event event;
+    while (count-- && events_.Pop(event))
+    {
+        if (debounced_lines_ & (1 << event.line))
+        {
+            RestartDebounce(event);
+            continue;
+        }
+        event_callbacks_[event.line](event);
+    }
+}
+
+void Pin::RestartDebounce(const Event &event)
+{
+    // Every edge restarts the wait, the level is only looked at once the line stayed quiet
+    uint8_t line = event.line;
+    last_edge_ticks_[line] = event.ticks;
+    System::StopTimer(debounce_timers_[line]);
+    debounce_timers_[line] = System::StartTimer(lockout_ms_[line], [line]
+                                                { DebounceExpired(line); });
+    if (debounce_timers_[line] == System::INVALID_TIMER)
+    {
+        event_overflows_ = event_overflows_ + 1;
+    }
+}
+
+void Pin::DebounceExpired(uint8_t line)
+{
+    debounce_timers_[line] = System::INVALID_TIMER;
+    if (!(debounced_lines_ & (1 << line)))
+    {
+        return; // Attached otherwise meanwhile
+    }
+
+    uint8_t pin = line_pins_[line];
+    bool level = Pin(static_cast<PortName>(pin >> 5), pin & 0x1F).Read();
+
+    // Bounces that ended on the previous level are no press at all
+    bool previous = (debounce_levels_ & (1 << line)) != 0;
+    if (level == previous)
+    {
+        return;
+    }
+    if (level)
+    {
+        debounce_levels_ |= 1 << line;
+    }
+    else
+    {
+        debounce_levels_ &= ~(1 << line);
+    }
+
+    InterruptMode mode = debounce_modes_[line];
+    bool wanted = mode == InterruptMode::CHANGE ||
+                  ((mode == InterruptMode::RISING || mode == InterruptMode::HIGH) && level) ||
+                  ((mode == InterruptMode::FALLING || mode == InterruptMode::LOW) && !level);
+    if (wanted)
+    {
+        Event event;
+        event.ticks = last_edge_ticks_[line];
+        event.line = line;
+        event.level = level;
+        event_callbacks_[line](event);
+    }
+}
+
+bool Pin::HasEvents()
+{
+    return !events_.IsEmpty();
+}
+
+uint32_t Pin::GetEventOverflows()
+{
+    return event_overflows_;
+}
+
+void Pin::InterruptHandler(uint8_t line)
+{
+    if (!(deferred_lines_ & (1 << line)))
+    {
+        interrupt_callbacks_[line]();
+        return;
+    }
+
+    uint8_t pin = line_pins_[line];
+    Event event;
+    event.ticks = static_cast<uint32_t>(System::GetTicks());
+    event.line = line;
+    event.level = Pin(static_cast<PortName>(pin >> 5), pin & 0x1F).Read();
+
+    if (!events_.Push(event))
+    {
+        event_overflows_ = event_overflows_ + 1;
+    }
+}
+
+// Index of the lowest set bit (value must not be 0), the M0+ has no CLZ/RBIT
+static inline uint8_t CountTrailingZeros(uint32_t value)
+{
+    static constexpr uint8_t DE_BRUIJN_POSITION[32] = {
+        0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8,
+        31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9};
+    return DE_BRUIJN_POSITION[((value & -value) * 0x077CB531U) >> 27];
 }
 
 } // namespace minisamd21
 
 extern "C" void EIC_Handler()
 {
-    // Get the interrupt flags to determine which pins triggered
-    uint32_t flags = EIC->INTFLAG.reg;
+    // Only lines with an enabled interrupt, the others may have stale flags
+    uint32_t flags = EIC->INTFLAG.reg & EIC->INTENSET.reg;
 
-    // Process all pins that have pending interrupts
-    for (int i = 0; i < 32; ++i)
-    {
-        if (flags & (1 << i))
-        {
-            // Call the handler for this pin
-            minisamd21::Pin::InterruptHandler(i);
+    // Clear them all at once, an edge during the callbacks flags the line again
+    EIC->INTFLAG.reg = flags;
 
-            // Clear the interrupt flag by writing 1 to it
-            EIC->INTFLAG.reg = (1 << i);
-        }
+    // Visit the set flags only, lowest line first
+    while (flags)
+    {
+        uint8_t line = minisamd21::CountTrailingZeros(flags);
+        flags &= flags - 1;
+        minisamd21::Pin::InterruptHandler(line);
     }
 }
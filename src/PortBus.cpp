@@ -0,0 +1,127 @@
+#include "minisamd21/PortBus.hpp"
+#include "samd21.h"
+
+namespace minisamd21
+{
+
+Pin::PortName PortBus::FirstPort(std::initializer_list<Pin> pins)
+{
+    return pins.size() == 0 ? Pin::PortName::PORTA : pins.begin()->GetPort();
+}
+
+PortBus::PortBus(std::initializer_list<Pin> pins) : port_(FirstPort(pins))
+{
+    if (pins.size() == 0 || pins.size() > MAX_PINS)
+    {
+        while (1)
+        {
+            // fail, a bus has 1 to MAX_PINS pins
+        }
+    }
+
+    for (const Pin &pin : pins)
+    {
+        if (pin.GetPort() != port_)
+        {
+            while (1)
+            {
+                // fail, all pins of a bus must be on the same port
+            }
+        }
+        if (mask_ & (1UL << pin.GetPin()))
+        {
+            while (1)
+            {
+                // fail, a pin appears twice in the bus
+            }
+        }
+        pins_[count_++] = pin.GetPin();
+        mask_ |= 1UL << pin.GetPin();
+    }
+
+    // A run of pins in ascending order is a plain shift
+    bool contiguous = true;
+    for (uint8_t i = 1; i < count_; ++i)
+    {
+        contiguous = contiguous && pins_[i] == pins_[0] + i;
+    }
+    if (contiguous)
+    {
+        shift_ = pins_[0];
+        return;
+    }
+
+    for (uint8_t nibble = 0; nibble < MAX_PINS / 4; ++nibble)
+    {
+        for (uint8_t value = 0; value < 16; ++value)
+        {
+            uint32_t bits = 0;
+            for (uint8_t bit = 0; bit < 4; ++bit)
+            {
+                uint8_t index = nibble * 4 + bit;
+                if ((value & (1 << bit)) && index < count_)
+                {
+                    bits |= 1UL << pins_[index];
+                }
+            }
+            scatter_[nibble][value] = bits;
+        }
+    }
+}
+
+void PortBus::Init(Pin::Mode mode, uint8_t options)
+{
+    // Read() goes over the IOBUS, the inputs must be sampled continuously
+    Pin::ConfigureGroup(port_, mask_, mode, options & ~Pin::SAMPLE_ON_DEMAND);
+}
+
+void PortBus::DeInit()
+{
+    for (uint8_t i = 0; i < count_; ++i)
+    {
+        Pin(port_, pins_[i]).DeInit();
+    }
+}
+
+void PortBus::Write(uint16_t value)
+{
+    uint32_t bits = Scatter(value);
+    PortGroup &group = PORT_IOBUS->Group[static_cast<uint8_t>(port_)];
+
+    // Masked write of OUT, one store changes every pin
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    group.OUT.reg = (group.OUT.reg & ~mask_) | bits;
+    __set_PRIMASK(primask);
+}
+
+uint16_t PortBus::Read() const
+{
+    // Inputs are continuously sampled (Pin::Init), IN can be read over the IOBUS
+    uint32_t in = PORT_IOBUS->Group[static_cast<uint8_t>(port_)].IN.reg;
+
+    if (shift_ != NOT_CONTIGUOUS)
+    {
+        return static_cast<uint16_t>((in & mask_) >> shift_);
+    }
+
+    uint16_t value = 0;
+    for (uint8_t i = 0; i < count_; ++i)
+    {
+        value |= static_cast<uint16_t>((in >> pins_[i]) & 1) << i;
+    }
+    return value;
+}
+
+uint32_t PortBus::Scatter(uint16_t value) const
+{
+    if (shift_ != NOT_CONTIGUOUS)
+    {
+        return (static_cast<uint32_t>(value) << shift_) & mask_;
+    }
+
+    return scatter_[0][value & 0xF] | scatter_[1][(value >> 4) & 0xF] |
+           scatter_[2][(value >> 8) & 0xF] | scatter_[3][value >> 12];
+}
+
+}
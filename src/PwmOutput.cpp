@@ -1,4 +1,7 @@
 #include "minisamd21/PwmOutput.hpp"
+#include "minisamd21/EventSystem.hpp"
+#include "minisamd21/GenericClock.hpp"
+#include "minisamd21/InputCapture.hpp"
 
 #include <algorithm>
 
@@ -108,6 +111,11 @@ void PwmOutput::SyncTCC(Tcc *TCCx)
     }
 }
 
+PwmOutput::~PwmOutput()
+{
+    System::UnsubscribeClockChange(OnClockChange, this);
+}
+
 void PwmOutput::Init(uint32_t frequency)
 {
     // Limit frequency to maximum
@@ -126,7 +134,7 @@ void PwmOutput::Init(uint32_t frequency)
     }
 
     // Enable appropriate peripheral clock based on timer type and instance
-    uint8_t timer_num;
+    uint8_t timer_num = 0;
     if (timer_type_ == TimerType::TCC)
     {
         Tcc *tcc = static_cast<Tcc *>(timer_instance_);
@@ -151,6 +159,14 @@ void PwmOutput::Init(uint32_t frequency)
         Tc *tc = static_cast<Tc *>(timer_instance_);
         timer_num = (tc == TC3) ? 3 : ((tc == TC4) ? 4 : 5); // Only TC3-5 are used
 
+        if (timer_num != 3 && InputCapture::IsInUse())
+        {
+            while (1)
+            {
+                // fail, TC4 and TC5 are taken by an InputCapture
+            }
+        }
+
         // Enable TC clock
         switch (timer_num)
         {
@@ -171,10 +187,13 @@ void PwmOutput::Init(uint32_t frequency)
         }
     }
 
+    timer_num_ = timer_num;
+
     // Enable GCLK for TCC and TC
     if (!timer_enabled_[timer_num])
     {
         timer_enabled_[timer_num] = true;
+        timer_frequency_[timer_num] = frequency_;
 
         // Determine GCLK_CLKCTRL_ID based on the timer
         uint16_t GCLK_ID;
@@ -198,14 +217,7 @@ void PwmOutput::Init(uint32_t frequency)
         }
 
         // Connect the timer to GCLK0 (48MHz)
-        GCLK->CLKCTRL.reg = GCLK_CLKCTRL_CLKEN |
-                            GCLK_CLKCTRL_GEN_GCLK0 |
-                            GCLK_ID;
-
-        while (GCLK->STATUS.bit.SYNCBUSY)
-        {
-            // Wait for synchronization
-        }
+        GenericClock::Connect(GCLK_ID, GenericClock::MAIN);
 
         // Configure the timer
         if (timer_type_ == TimerType::TCC)
@@ -222,9 +234,7 @@ void PwmOutput::Init(uint32_t frequency)
             SyncTCC(tcc);
 
             // Calculate and set the PER register based on frequency
-            uint32_t period = System::FREQUENCY / frequency_; // 48MHz / desired frequency
-            tcc->PER.reg = period - 1;
-            SyncTCC(tcc);
+            SetPeriod(System::GetFrequency());
 
             // Set initial duty cycle to 0
             tcc->CC[timer_channel_].reg = 0;
@@ -248,9 +258,7 @@ void PwmOutput::Init(uint32_t frequency)
             SyncTC(tc);
 
             // Calculate and set the PER register based on frequency
-            uint32_t period = System::FREQUENCY / frequency_; // 48MHz / desired frequency
-            tc->COUNT16.CC[0].reg = period - 1;
-            SyncTC(tc);
+            SetPeriod(System::GetFrequency());
 
             // Set initial duty cycle to 0
             tc->COUNT16.CC[timer_channel_].reg = 0;
@@ -262,10 +270,99 @@ void PwmOutput::Init(uint32_t frequency)
         }
     }
 
+    // Keep frequency and duty cycle when the core clock changes
+    System::SubscribeClockChange(OnClockChange, this);
+
     // Set initial duty cycle to 0.0
     Write(0.0f);
 }
 
+bool PwmOutput::SetRetriggerEvent(uint8_t channel)
+{
+    if (timer_instance_ == nullptr)
+    {
+        return false;
+    }
+
+    bool enable = channel != EventSystem::NONE;
+    uint8_t user;
+
+    if (timer_type_ == TimerType::TCC)
+    {
+        static constexpr uint8_t TCC_USERS[] = {EVSYS_ID_USER_TCC0_EV_0, EVSYS_ID_USER_TCC1_EV_0, EVSYS_ID_USER_TCC2_EV_0};
+        user = TCC_USERS[timer_num_];
+
+        // EVCTRL is enable-protected
+        Tcc *tcc = static_cast<Tcc *>(timer_instance_);
+        tcc->CTRLA.bit.ENABLE = 0;
+        SyncTCC(tcc);
+
+        tcc->EVCTRL.reg = enable ? (TCC_EVCTRL_EVACT0_RETRIGGER | TCC_EVCTRL_TCEI0) : 0;
+
+        tcc->CTRLA.reg |= TCC_CTRLA_ENABLE;
+        SyncTCC(tcc);
+    }
+    else
+    {
+        user = EVSYS_ID_USER_TC3_EVU + (timer_num_ - 3);
+
+        Tc *tc = static_cast<Tc *>(timer_instance_);
+        tc->COUNT16.EVCTRL.reg = enable ? (TC_EVCTRL_EVACT_RETRIGGER | TC_EVCTRL_TCEI) : 0;
+    }
+
+    if (enable)
+    {
+        EventSystem::Connect(channel, user);
+    }
+    else
+    {
+        EventSystem::Disconnect(user);
+    }
+    return true;
+}
+
+void PwmOutput::SetPeriod(uint32_t clock_frequency)
+{
+    // The period belongs to the timer, which may be shared with other outputs
+    uint32_t period = clock_frequency / timer_frequency_[timer_num_]; // GCLK0 / desired frequency
+
+    // GCLK0 follows the performance level, keep the period within what the counter
+    // can do: the nearest reachable frequency rather than a wrapped PER or CC0
+    uint32_t max_period = (timer_type_ == TimerType::TCC && timer_num_ < 2) ? (1UL << 24) : (1UL << 16);
+    if (period < MIN_PERIOD)
+    {
+        period = MIN_PERIOD;
+    }
+    else if (period > max_period)
+    {
+        period = max_period;
+    }
+
+    if (timer_type_ == TimerType::TCC)
+    {
+        Tcc *tcc = static_cast<Tcc *>(timer_instance_);
+        tcc->PER.reg = period - 1;
+        SyncTCC(tcc);
+    }
+    else if (timer_type_ == TimerType::TC)
+    {
+        // 16-bit TC uses CC0 as the period in NPWM mode
+        Tc *tc = static_cast<Tc *>(timer_instance_);
+        tc->COUNT16.CC[0].reg = period - 1;
+        SyncTC(tc);
+    }
+}
+
+void PwmOutput::OnClockChange(void *context, uint32_t frequency)
+{
+    PwmOutput *pwm = static_cast<PwmOutput *>(context);
+
+    // Outputs sharing a timer all write the same period, so the order of the
+    // callbacks does not matter
+    pwm->SetPeriod(frequency);
+    pwm->Write(pwm->duty_cycle_);
+}
+
 void PwmOutput::Write(float duty_cycle)
 {
     // Constrain duty cycle to 0.0-1.0 range
@@ -1,4 +1,6 @@
 #include "minisamd21/Sleep.hpp"
+#include "minisamd21/Pin.hpp"
+#include "minisamd21/System.hpp"
 
 #include <samd21.h>
 
@@ -13,8 +15,28 @@ void Sleep::Init()
 
 void Sleep::SleepNow()
 {
+    // Wake up in time for the next software timer
+    uint64_t deadline;
+    if (System::GetNextDeadline(deadline) && !System::SetWakeup(deadline))
+    {
+        return; // Due right now, no point in sleeping
+    }
+
+    // With interrupts masked, an edge queued after the check still ends the WFI
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (Pin::HasEvents())
+    {
+        __set_PRIMASK(primask);
+        return; // Deferred pin interrupts to process first
+    }
+
+    // SysTick would wake the core on each wrap, the RTC carries the cycle count instead
+    System::SuspendCycleCounter();
     __DSB();
     __WFI();
+    System::ResumeCycleCounter();
+    __set_PRIMASK(primask);
 }
 
 } // namespace minisamd21
@@ -1,5 +1,9 @@
 #include "minisamd21/System.hpp"
 #include "samd21.h"
+#include "minisamd21/GenericClock.hpp"
+
+// Stored by Reset_Handler
+extern "C" uint32_t boot_cycles;
 
 namespace minisamd21
 {
@@ -9,56 +13,401 @@ void System::Init(ClockSource source)
     // Set Flash wait states for 48 MHz
     NVMCTRL->CTRLB.bit.RWS = 1; // 1 wait state for 48MHz
 
+    // Start the RTC timebase first (replaces the 1ms SysTick interrupt),
+    // the clock startup below uses it for timeouts
+    InitTimebase();
+
     // Set the clock source based on the provided parameter
-    if (source == ClockSource::INTERNAL_OSC)
-    {
-        // Enable OSC8M (internal 8MHz oscillator) with defaults
-        SYSCTRL->OSC8M.bit.PRESC = 0; // No prescaler (divide by 1)
-        SYSCTRL->OSC8M.bit.ONDEMAND = 0;
-        SYSCTRL->OSC8M.bit.RUNSTDBY = 0;
-        SYSCTRL->OSC8M.bit.ENABLE = 1;
-        while (!(SYSCTRL->PCLKSR.reg & SYSCTRL_PCLKSR_OSC8MRDY))
-            ;
-
-        // Configure DFLL48M to use internal reference
-        SYSCTRL->DFLLCTRL.reg = 0; // Make sure DFLL is disabled
-        while (!(SYSCTRL->PCLKSR.reg & SYSCTRL_PCLKSR_DFLLRDY))
-            ;
-
-        // Set DFLL coarse and fine values from NVM calibration values
-        uint32_t coarse = (*((uint32_t *)FUSES_DFLL48M_COARSE_CAL_ADDR) & FUSES_DFLL48M_COARSE_CAL_Msk) >> FUSES_DFLL48M_COARSE_CAL_Pos;
-        SYSCTRL->DFLLVAL.reg = SYSCTRL_DFLLVAL_COARSE(coarse) | SYSCTRL_DFLLVAL_FINE(0x1ff);
-
-        // Configure DFLL in open-loop mode
-        SYSCTRL->DFLLCTRL.reg = SYSCTRL_DFLLCTRL_ENABLE;
-        while (!(SYSCTRL->PCLKSR.reg & SYSCTRL_PCLKSR_DFLLRDY))
-            ;
-
-        // Configure GCLK0 to use DFLL48M
-        GCLK->GENDIV.reg = GCLK_GENDIV_ID(0) | GCLK_GENDIV_DIV(1); // No division
-        while (GCLK->STATUS.reg & GCLK_STATUS_SYNCBUSY)
-            ;
-
-        // Configure GCLK0 to use DFLL48M and enable it
-        GCLK->GENCTRL.reg = GCLK_GENCTRL_ID(0) |
-                            GCLK_GENCTRL_SRC_DFLL48M |
-                            GCLK_GENCTRL_IDC |
-                            GCLK_GENCTRL_GENEN;
-        while (GCLK->STATUS.reg & GCLK_STATUS_SYNCBUSY)
-            ;
-    }
-    else if (source == ClockSource::EXTERNAL_XTAL)
-    {
-        // TODO
-    }
-
-    // Configure SysTick to trigger every 1 ms
-    constexpr uint32_t ticks = FREQUENCY / 1000; // SystemCoreClock is the CPU clock frequency
-    SysTick->LOAD = ticks - 1;                   // Set reload register
+    clock_source_ = ClockSource::INTERNAL_OSC;
+    if (source == ClockSource::EXTERNAL_XTAL)
+    {
+        if (StartXosc32k() && StartDfllClosedLoop())
+        {
+            clock_source_ = ClockSource::EXTERNAL_XTAL;
+        }
+        else
+        {
+            // Crystal did not start or DFLL did not lock, fall back to open-loop
+            if (xosc32k_gclk_ != GenericClock::NONE)
+            {
+                GenericClock::Disconnect(GCLK_CLKCTRL_ID_DFLL48_Val);
+                GenericClock::Release(xosc32k_gclk_);
+                xosc32k_gclk_ = GenericClock::NONE;
+            }
+            SYSCTRL->XOSC32K.bit.ENABLE = 0;
+            StartDfllOpenLoop();
+        }
+    }
+    else
+    {
+        StartDfllOpenLoop();
+    }
+
+    // Configure GCLK0 to use DFLL48M
+    GCLK->GENDIV.reg = GCLK_GENDIV_ID(0) | GCLK_GENDIV_DIV(1); // No division
+    while (GCLK->STATUS.reg & GCLK_STATUS_SYNCBUSY)
+        ;
+
+    // Configure GCLK0 to use DFLL48M and enable it
+    GCLK->GENCTRL.reg = GCLK_GENCTRL_ID(0) |
+                        GCLK_GENCTRL_SRC_DFLL48M |
+                        GCLK_GENCTRL_IDC |
+                        GCLK_GENCTRL_GENEN;
+    while (GCLK->STATUS.reg & GCLK_STATUS_SYNCBUSY)
+        ;
+
+    // Software timers run off the timebase
+    InitTimers();
+
+    // Start the SysTick cycle counter for fine timestamps
+    InitCycleCounter();
+
+    // Measure the delay loop against SysTick
+    CalibrateDelay();
+
+    if (clock_source_ == ClockSource::EXTERNAL_XTAL)
+    {
+        // Run the timebase from the crystal as well (sharing its generator),
+        // then use it to measure the real core clock
+        uint8_t crystal = GenericClock::Acquire(GenericClock::Source::XOSC32K, 1, true);
+        if (crystal == GenericClock::NONE)
+        {
+            while (1)
+            {
+                // fail, no generator left for the timebase
+            }
+        }
+        GenericClock::Connect(GCLK_CLKCTRL_ID_RTC_Val, crystal);
+        GenericClock::Release(timebase_gclk_);
+        timebase_gclk_ = crystal;
+
+        dfll_frequency_ = MeasureFrequency();
+    }
+    else
+    {
+        // No accurate reference available, assume the nominal frequency
+        dfll_frequency_ = FREQUENCY;
+    }
+    performance_level_ = PerformanceLevel::HIGH;
+    SetFrequency(dfll_frequency_);
+}
+
+uint32_t System::GetFrequency()
+{
+    return frequency_;
+}
+
+System::ClockSource System::GetClockSource()
+{
+    return clock_source_;
+}
+
+void System::SetPerformanceLevel(PerformanceLevel level)
+{
+    if (level == performance_level_)
+    {
+        return;
+    }
+
+    uint32_t divider = 1;
+    switch (level)
+    {
+    case PerformanceLevel::HIGH:
+        divider = 1;
+        break;
+    case PerformanceLevel::MEDIUM:
+        divider = 6;
+        break;
+    case PerformanceLevel::LOW:
+        divider = 48;
+        break;
+    }
+
+    uint32_t frequency = dfll_frequency_ / divider;
+
+    // Flash needs the wait state before the clock goes up
+    if (frequency > MAX_ZERO_WAIT_FREQUENCY)
+    {
+        NVMCTRL->CTRLB.bit.RWS = 1;
+    }
+
+    // Carry the microsecond count over, cycles change meaning from here on
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    us_base_ = GetUs();
+    us_base_cycles_ = GetCycles();
+
+    GCLK->GENDIV.reg = GCLK_GENDIV_ID(0) | GCLK_GENDIV_DIV(divider);
+    while (GCLK->STATUS.reg & GCLK_STATUS_SYNCBUSY)
+        ;
+
+    SetFrequency(frequency);
+    performance_level_ = level;
+
+    __set_PRIMASK(primask);
+
+    if (frequency <= MAX_ZERO_WAIT_FREQUENCY)
+    {
+        NVMCTRL->CTRLB.bit.RWS = 0;
+    }
+
+    // The wait states change the overhead of DelayCycles, measure it once for each setting
+    uint32_t overhead = delay_overheads_[NVMCTRL->CTRLB.bit.RWS ? 1 : 0];
+    if (overhead == DELAY_NOT_CALIBRATED)
+    {
+        CalibrateDelay();
+    }
+    else
+    {
+        delay_overhead_ = overhead;
+    }
+
+    // Retime the peripherals running from GCLK0
+    for (const auto &subscriber : clock_subscribers_)
+    {
+        if (subscriber.callback != nullptr)
+        {
+            subscriber.callback(subscriber.context, frequency);
+        }
+    }
+}
+
+uint32_t System::GetDfllFrequency()
+{
+    return dfll_frequency_;
+}
+
+System::PerformanceLevel System::GetPerformanceLevel()
+{
+    return performance_level_;
+}
+
+bool System::SubscribeClockChange(ClockChangeCallback callback, void *context)
+{
+    ClockSubscriber *free_slot = nullptr;
+    for (auto &subscriber : clock_subscribers_)
+    {
+        if (subscriber.callback == callback && subscriber.context == context)
+        {
+            return true; // Already subscribed
+        }
+        if (subscriber.callback == nullptr && free_slot == nullptr)
+        {
+            free_slot = &subscriber;
+        }
+    }
+
+    if (free_slot == nullptr)
+    {
+        return false;
+    }
+
+    free_slot->context = context;
+    free_slot->callback = callback;
+    return true;
+}
+
+void System::UnsubscribeClockChange(ClockChangeCallback callback, void *context)
+{
+    for (auto &subscriber : clock_subscribers_)
+    {
+        if (subscriber.callback == callback && subscriber.context == context)
+        {
+            subscriber.callback = nullptr;
+            subscriber.context = nullptr;
+        }
+    }
+}
+
+void System::SetFrequency(uint32_t frequency)
+{
+    frequency_ = frequency;
+    cycles_per_us_ = (frequency + 500000) / 1000000;
+}
+
+bool System::WaitForClockStatus(uint32_t mask, uint32_t timeout_ms)
+{
+    uint64_t deadline = GetTicks() + MsToTicks(timeout_ms);
+    while ((SYSCTRL->PCLKSR.reg & mask) != mask)
+    {
+        if (GetTicks() > deadline)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool System::StartXosc32k()
+{
+    // Configure the crystal oscillator first, enable it with a separate write
+    SYSCTRL->XOSC32K.reg = SYSCTRL_XOSC32K_STARTUP(XOSC32K_STARTUP) |
+                           SYSCTRL_XOSC32K_XTALEN |
+                           SYSCTRL_XOSC32K_EN32K |
+                           SYSCTRL_XOSC32K_RUNSTDBY;
+    SYSCTRL->XOSC32K.bit.ENABLE = 1;
+
+    if (!WaitForClockStatus(SYSCTRL_PCLKSR_XOSC32KRDY, XOSC32K_TIMEOUT_MS))
+    {
+        return false;
+    }
+
+    // Feed the crystal to the DFLL reference input, running in standby
+    // so the timebase can share the generator later
+    xosc32k_gclk_ = GenericClock::Acquire(GenericClock::Source::XOSC32K, 1, true);
+    if (xosc32k_gclk_ == GenericClock::NONE)
+    {
+        return false;
+    }
+    GenericClock::Connect(GCLK_CLKCTRL_ID_DFLL48_Val, xosc32k_gclk_);
+
+    return true;
+}
+
+bool System::StartDfllClosedLoop()
+{
+    // The DFLL must be enabled with ONDEMAND cleared before its registers are written (errata)
+    SYSCTRL->DFLLCTRL.reg = SYSCTRL_DFLLCTRL_ENABLE;
+    while (!(SYSCTRL->PCLKSR.reg & SYSCTRL_PCLKSR_DFLLRDY))
+        ;
+
+    // Start from the factory coarse value so the loop only has to fine tune
+    uint32_t coarse = (*((uint32_t *)FUSES_DFLL48M_COARSE_CAL_ADDR) & FUSES_DFLL48M_COARSE_CAL_Msk) >> FUSES_DFLL48M_COARSE_CAL_Pos;
+    SYSCTRL->DFLLVAL.reg = SYSCTRL_DFLLVAL_COARSE(coarse) | SYSCTRL_DFLLVAL_FINE(0x200);
+    while (!(SYSCTRL->PCLKSR.reg & SYSCTRL_PCLKSR_DFLLRDY))
+        ;
+
+    // Multiply the 32.768kHz reference up to 48MHz, use a quarter of the maximum steps
+    SYSCTRL->DFLLMUL.reg = SYSCTRL_DFLLMUL_CSTEP(0x1f / 4) |
+                           SYSCTRL_DFLLMUL_FSTEP(0x3ff / 4) |
+                           SYSCTRL_DFLLMUL_MUL(DFLL_MULTIPLIER);
+    while (!(SYSCTRL->PCLKSR.reg & SYSCTRL_PCLKSR_DFLLRDY))
+        ;
+
+    // Switch to closed-loop mode
+    SYSCTRL->DFLLCTRL.reg = SYSCTRL_DFLLCTRL_ENABLE | SYSCTRL_DFLLCTRL_MODE;
+    while (!(SYSCTRL->PCLKSR.reg & SYSCTRL_PCLKSR_DFLLRDY))
+        ;
+
+    // Wait for coarse and fine lock
+    bool locked = WaitForClockStatus(SYSCTRL_PCLKSR_DFLLLCKC | SYSCTRL_PCLKSR_DFLLLCKF, DFLL_LOCK_TIMEOUT_MS);
+    if (!locked || (SYSCTRL->PCLKSR.reg & SYSCTRL_PCLKSR_DFLLOOB))
+    {
+        return false;
+    }
+
+    return true;
+}
+
+void System::StartDfllOpenLoop()
+{
+    // Enable OSC8M (internal 8MHz oscillator) with defaults
+    SYSCTRL->OSC8M.bit.PRESC = 0; // No prescaler (divide by 1)
+    SYSCTRL->OSC8M.bit.ONDEMAND = 0;
+    SYSCTRL->OSC8M.bit.RUNSTDBY = 0;
+    SYSCTRL->OSC8M.bit.ENABLE = 1;
+    while (!(SYSCTRL->PCLKSR.reg & SYSCTRL_PCLKSR_OSC8MRDY))
+        ;
+
+    // Configure DFLL48M to use internal reference
+    SYSCTRL->DFLLCTRL.reg = 0; // Make sure DFLL is disabled
+    while (!(SYSCTRL->PCLKSR.reg & SYSCTRL_PCLKSR_DFLLRDY))
+        ;
+
+    // Set DFLL coarse and fine values from NVM calibration values
+    uint32_t coarse = (*((uint32_t *)FUSES_DFLL48M_COARSE_CAL_ADDR) & FUSES_DFLL48M_COARSE_CAL_Msk) >> FUSES_DFLL48M_COARSE_CAL_Pos;
+    SYSCTRL->DFLLVAL.reg = SYSCTRL_DFLLVAL_COARSE(coarse) | SYSCTRL_DFLLVAL_FINE(0x1ff);
+
+    // Configure DFLL in open-loop mode
+    SYSCTRL->DFLLCTRL.reg = SYSCTRL_DFLLCTRL_ENABLE;
+    while (!(SYSCTRL->PCLKSR.reg & SYSCTRL_PCLKSR_DFLLRDY))
+        ;
+}
+
+uint32_t System::MeasureFrequency()
+{
+    // Align to a timebase tick edge
+    uint64_t start_ticks = GetTicks();
+    while (GetTicks() == start_ticks)
+        ;
+    start_ticks = GetTicks();
+    uint64_t start_cycles = GetCycles();
+
+    // Count core cycles over a fixed number of crystal ticks
+    while (GetTicks() - start_ticks < MEASURE_TICKS)
+        ;
+    uint64_t cycles = GetCycles() - start_cycles;
+
+    return static_cast<uint32_t>(cycles * TICK_FREQUENCY / MEASURE_TICKS);
+}
+
+void System::SyncRtc()
+{
+    while (RTC->MODE0.STATUS.bit.SYNCBUSY)
+        ;
+}
+
+void System::InitTimebase()
+{
+    // Enable the APBA clock for the RTC
+    PM->APBAMASK.reg |= PM_APBAMASK_RTC;
+
+    // Clock the timebase from the ultra low power 32kHz oscillator,
+    // keep it running in standby so the count survives sleep
+    timebase_gclk_ = GenericClock::Acquire(GenericClock::Source::OSCULP32K, 1, true);
+    if (timebase_gclk_ == GenericClock::NONE)
+    {
+        while (1)
+        {
+            // fail, no generator left for the timebase
+        }
+    }
+    GenericClock::Connect(GCLK_CLKCTRL_ID_RTC_Val, timebase_gclk_);
+
+    // Reset the RTC
+    RTC->MODE0.CTRL.bit.ENABLE = 0;
+    SyncRtc();
+    RTC->MODE0.CTRL.bit.SWRST = 1;
+    while (RTC->MODE0.CTRL.bit.SWRST)
+        ;
+
+    // Mode 0: free-running 32-bit counter, no prescaler (one tick = 1/32768 s)
+    RTC->MODE0.CTRL.reg = RTC_MODE0_CTRL_MODE_COUNT32 | RTC_MODE0_CTRL_PRESCALER_DIV1;
+    SyncRtc();
+
+    // Keep COUNT continuously synchronized so reads do not need a read request each time
+    RTC->MODE0.READREQ.reg = RTC_READREQ_RREQ | RTC_READREQ_RCONT | RTC_READREQ_ADDR(RTC_MODE0_COUNT_OFFSET);
+    SyncRtc();
+
+    timebase_overflows_ = 0;
+
+    // Overflow is the only timebase interrupt
+    RTC->MODE0.INTFLAG.reg = RTC_MODE0_INTFLAG_OVF;
+    RTC->MODE0.INTENSET.reg = RTC_MODE0_INTENSET_OVF;
+
+    NVIC_DisableIRQ(RTC_IRQn);
+    NVIC_ClearPendingIRQ(RTC_IRQn);
+    NVIC_SetPriority(RTC_IRQn, 0);
+    NVIC_EnableIRQ(RTC_IRQn);
+
+    RTC->MODE0.CTRL.bit.ENABLE = 1;
+    SyncRtc();
+}
+
+void System::InitCycleCounter()
+{
+    cycles_ = 0;
+    us_base_ = 0;
+    us_base_cycles_ = 0;
+
+    SysTick->LOAD = SYSTICK_RELOAD;              // Full 24-bit range, wraps ~3 times per second at 48MHz
     SysTick->VAL = 0;                            // Reset the SysTick counter value
     SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | // Use processor clock
-                    SysTick_CTRL_TICKINT_Msk |   // Enable SysTick interrupt
+                    SysTick_CTRL_TICKINT_Msk |   // Enable SysTick interrupt (wrap only)
                     SysTick_CTRL_ENABLE_Msk;     // Enable SysTick
+
+    NVIC_SetPriority(SysTick_IRQn, 0);
 }
 
 // Delay for specified milliseconds using busy-wait on the millisecond counter
@@ -69,44 +418,215 @@ void System::DelayMs(uint64_t delay_ms)
         ;
 }
 
-/**
- * Taken from Arduino SAMD core (LGPL license)
- * Copyright (c) 2015 Arduino LLC. All right reserved.
- */
+// Delay for specified microseconds using the calibrated cycle delay
 void System::DelayUs(uint32_t delay_us)
 {
-    if (delay_us <= 0)
+    // Split long delays so the cycle count fits in 32 bits
+    while (delay_us > 1000000)
+    {
+        DelayCycles(frequency_);
+        delay_us -= 1000000;
+    }
+    DelayCycles(delay_us * cycles_per_us_);
+}
+
+// Delay for specified nanoseconds using the calibrated cycle delay
+void System::DelayNs(uint32_t delay_ns)
+{
+    if (delay_ns > 80000000)
+    {
+        // Product below would overflow, microsecond resolution is plenty here
+        DelayUs(delay_ns / 1000);
+        return;
+    }
+    DelayCycles((delay_ns * cycles_per_us_ + 999) / 1000);
+}
+
+// Delay for the specified number of core cycles
+void System::DelayCycles(uint32_t cycles)
+{
+    if (cycles <= delay_overhead_)
     {
         return;
     }
-    // VARIANT_MCK / 1000000 == cycles needed to delay 1uS
-    //                     3 == cycles used in a loop
-    uint32_t n = delay_us * (FREQUENCY / 1000000) / 3;
+
+    // Round up so the delay is never shorter than requested
+    uint32_t iterations = (cycles - delay_overhead_ + delay_loop_cycles_ - 1) / delay_loop_cycles_;
+    DelayLoop(iterations);
+}
+
+void System::CalibrateDelay()
+{
+    constexpr uint32_t ITERATIONS = 1000;
+    constexpr uint32_t TEST_CYCLES = 10000;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    // Cost of the measurement itself
+    uint32_t empty = MeasureCycles(nullptr, 0);
+
+    // Cost of one loop iteration, call overhead cancels out in the difference
+    uint32_t short_loop = MeasureCycles(DelayLoop, 1);
+    uint32_t long_loop = MeasureCycles(DelayLoop, ITERATIONS + 1);
+    delay_loop_cycles_ = (long_loop - short_loop + ITERATIONS / 2) / ITERATIONS;
+
+    // Everything DelayCycles spends outside the loop (call, division, return)
+    delay_overhead_ = 0;
+    uint32_t measured = MeasureCycles(DelayCycles, TEST_CYCLES) - empty;
+    delay_overhead_ = measured > TEST_CYCLES ? measured - TEST_CYCLES : 0;
+    delay_overheads_[NVMCTRL->CTRLB.bit.RWS ? 1 : 0] = delay_overhead_;
+
+    __set_PRIMASK(primask);
+}
+
+uint32_t System::MeasureCycles(void (*function)(uint32_t), uint32_t argument)
+{
+    // SysTick counts down, short measurements never wrap more than once
+    uint32_t start = SysTick->VAL;
+    if (function != nullptr)
+    {
+        function(argument);
+    }
+    uint32_t end = SysTick->VAL;
+    return (start - end) & SYSTICK_RELOAD;
+}
+
+// Busy loop executed from RAM, so its cost does not depend on flash wait states
+// or on how the loop happens to be aligned in flash (SUBS + taken BNE = 3 cycles on M0+)
+__attribute__((section(".ramfunc"), long_call, noinline, aligned(4))) void System::DelayLoop(uint32_t iterations)
+{
     __asm__ __volatile__(
-        "1:              \n"
-        "   sub %0, #1   \n" // substract 1 from %0 (n)
-        "   bne 1b       \n" // if result is not 0 jump to 1
-        : "+r"(n)            // '%0' is n variable with RW constraints
-        :                    // no input
-        :                    // no clobber
+        "1:               \n"
+        "   subs %0, #1   \n" // substract 1 from %0 (iterations)
+        "   bne 1b        \n" // if result is not 0 jump to 1
+        : "+l"(iterations)     // '%0' is iterations variable with RW constraints
+        :                      // no input
+        : "cc"                 // flags are modified
     );
 }
 
 // Get elapsed milliseconds
 uint64_t System::GetMs()
 {
-    return millis_;
+    return TicksToMs(GetTicks());
+}
+
+// Get elapsed timebase ticks as a tear-free 64-bit value
+uint64_t System::GetTicks()
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    uint32_t high = timebase_overflows_;
+    uint32_t low = RTC->MODE0.COUNT.reg;
+
+    // An overflow may be pending but not yet handled (interrupts are masked here,
+    // or we are called from a higher priority ISR). The low word has then wrapped,
+    // so account for it unless COUNT was read just before the wrap.
+    if ((RTC->MODE0.INTFLAG.reg & RTC_MODE0_INTFLAG_OVF) && low < 0x80000000)
+    {
+        high++;
+    }
+
+    __set_PRIMASK(primask);
+
+    return (static_cast<uint64_t>(high) << 32) | low;
+}
+
+// Get elapsed CPU cycles as a tear-free 64-bit value
+uint64_t System::GetCycles()
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    uint64_t base = cycles_;
+    uint32_t val = SysTick->VAL;
+
+    // SysTick may have reloaded before or just after VAL was read while its
+    // interrupt could not run. The pending bit tells us it did; VAL is then
+    // read again so it is guaranteed to belong to the new period.
+    if (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk)
+    {
+        val = SysTick->VAL;
+        base += SYSTICK_RELOAD + 1;
+    }
+
+    __set_PRIMASK(primask);
+
+    return base + (SYSTICK_RELOAD - val);
+}
+
+void System::SuspendCycleCounter()
+{
+    // Fold the pending wrap and the current count into cycles_, then restart from 0
+    cycles_ = GetCycles();
+    suspend_ticks_ = GetTicks();
+    SysTick->CTRL = 0;
+    SCB->ICSR = SCB_ICSR_PENDSTCLR_Msk;
+    SysTick->VAL = 0;
+}
+
+void System::ResumeCycleCounter()
+{
+    // Split the conversion so the intermediate product cannot overflow
+    uint64_t ticks = GetTicks() - suspend_ticks_;
+    cycles_ = cycles_ + (ticks / TICK_FREQUENCY) * frequency_ +
+              ((ticks % TICK_FREQUENCY) * frequency_) / TICK_FREQUENCY;
+
+    SysTick->VAL = 0;
+    SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk |
+                    SysTick_CTRL_TICKINT_Msk |
+                    SysTick_CTRL_ENABLE_Msk;
 }
 
-// Public tick handler for SysTick ISR
-void System::Tick()
+// Get elapsed microseconds
+uint64_t System::GetUs()
 {
-    ++millis_;
+    // Split the division so the intermediate product cannot overflow
+    uint64_t cycles = GetCycles() - us_base_cycles_;
+    uint64_t seconds = cycles / frequency_;
+    uint64_t remainder = cycles % frequency_;
+    return us_base_ + seconds * 1000000 + (remainder * 1000000) / frequency_;
+}
+
+// Get the boot time measured by Reset_Handler
+uint32_t System::GetBootCycles()
+{
+    return boot_cycles;
+}
+
+// Public wrap handler for SysTick ISR
+void System::CycleCounterInterruptHandler()
+{
+    cycles_ = cycles_ + (SYSTICK_RELOAD + 1);
+}
+
+// Public overflow and wakeup handler for RTC ISR
+void System::TimebaseInterruptHandler()
+{
+    if (RTC->MODE0.INTFLAG.reg & RTC_MODE0_INTFLAG_OVF)
+    {
+        RTC->MODE0.INTFLAG.reg = RTC_MODE0_INTFLAG_OVF;
+        timebase_overflows_ = timebase_overflows_ + 1;
+    }
+
+    // Wakeup compare is one-shot, the timers are run from ProcessTimers()
+    if (RTC->MODE0.INTFLAG.reg & RTC_MODE0_INTFLAG_CMP0)
+    {
+        RTC->MODE0.INTENCLR.reg = RTC_MODE0_INTENCLR_CMP0;
+        RTC->MODE0.INTFLAG.reg = RTC_MODE0_INTFLAG_CMP0;
+    }
 }
 
 }
 
 extern "C" void SysTick_Handler(void)
 {
-    minisamd21::System::Tick();
-}
\ No newline at end of file
+    minisamd21::System::CycleCounterInterruptHandler();
+}
+
+extern "C" void RTC_Handler(void)
+{
+    minisamd21::System::TimebaseInterruptHandler();
+}
@@ -0,0 +1,398 @@
+#include "minisamd21/System.hpp"
+#include "samd21.h"
+#include "minisamd21/Executor.hpp"
+
+// Software timers of the System class
+//
+// Timers are kept in a hierarchical wheel: level 0 has one slot per timer tick,
+// each higher level slot covers a whole turn of the level below. When the wheel
+// reaches the start of a higher level slot, its timers are redistributed to the
+// lower levels (cascaded), so every timer is touched at most once per level.
+// All lists are doubly linked through pool indices, there is no heap.
+
+namespace minisamd21
+{
+
+void System::InitTimers()
+{
+    for (uint16_t &head : timer_lists_)
+    {
+        head = TIMER_NONE;
+    }
+    for (uint16_t &count : timer_level_count_)
+    {
+        count = 0;
+    }
+    for (uint16_t i = 0; i < MAX_TIMERS; ++i)
+    {
+        timers_[i].generation = 0;
+        LinkTimer(i, TIMER_FREE_LIST);
+    }
+    timer_time_ = GetTicks() >> TIMER_TICK_SHIFT;
+}
+
+System::TimerId System::StartTimer(uint32_t delay_ms, TimerCallback callback)
+{
+    return AddTimer(delay_ms, false, callback);
+}
+
+System::TimerId System::StartPeriodicTimer(uint32_t period_ms, TimerCallback callback)
+{
+    return AddTimer(period_ms, true, callback);
+}
+
+bool System::StopTimer(TimerId id)
+{
+    uint16_t index = id & 0xFF;
+    uint8_t generation = id >> 8;
+    if (id == INVALID_TIMER || index >= MAX_TIMERS)
+    {
+        return false;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    Timer &timer = timers_[index];
+    bool active = timer.generation == generation && timer.list != TIMER_FREE_LIST;
+    if (active)
+    {
+        UnlinkTimer(index);
+        FreeTimer(index);
+    }
+
+    __set_PRIMASK(primask);
+    return active;
+}
+
+void System::ProcessTimers()
+{
+    uint64_t now = GetTicks() >> TIMER_TICK_SHIFT;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    while (timer_time_ <= now)
+    {
+        uint64_t tick = timer_time_;
+
+        // Redistribute the higher level slots starting at this tick, top level first
+        for (uint8_t level = TIMER_LEVELS - 1; level > 0; --level)
+        {
+            uint8_t shift = TIMER_SLOT_BITS * level;
+            if ((tick & ((1ULL << shift) - 1)) == 0)
+            {
+                CascadeTimers(level, (tick >> shift) & (TIMER_SLOTS - 1));
+            }
+        }
+
+        // Collect the timers due at this tick
+        uint16_t slot = tick & (TIMER_SLOTS - 1);
+        while (timer_lists_[slot] != TIMER_NONE)
+        {
+            uint16_t index = timer_lists_[slot];
+            UnlinkTimer(index);
+            LinkTimer(index, TIMER_EXPIRED_LIST);
+        }
+
+        // Advance before the callbacks run, so timers they start land after this tick
+        timer_time_ = GetNextTimerTick(tick, now);
+
+        __set_PRIMASK(primask);
+        RunExpiredTimers();
+        __disable_irq();
+    }
+
+    __set_PRIMASK(primask);
+}
+
+bool System::SleepAwaiter::await_suspend(std::coroutine_handle<> handle) const
+{
+    auto wake = [handle]
+    {
+        Executor::Schedule(handle);
+    };
+
+    // No timer left, continue right away rather than never
+    return StartTimer(delay_ms, wake) != INVALID_TIMER;
+}
+
+bool System::GetNextDeadline(uint64_t &ticks)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    // Slots of a level are ordered from the current one on, so the earliest timer of a level
+    // is in its first occupied slot. Levels overlap in time, check each of them.
+    uint64_t earliest = UINT64_MAX;
+    for (uint8_t level = 0; level <= TIMER_LEVELS; ++level)
+    {
+        uint16_t list = TIMER_NONE;
+        if (level == TIMER_LEVELS)
+        {
+            // Expired but not yet run (called from a timer callback)
+            list = TIMER_EXPIRED_LIST;
+        }
+        else if (timer_level_count_[level] > 0)
+        {
+            uint64_t start = timer_time_ >> (TIMER_SLOT_BITS * level);
+            for (uint16_t i = 0; i < TIMER_SLOTS; ++i)
+            {
+                uint16_t candidate = level * TIMER_SLOTS + ((start + i) & (TIMER_SLOTS - 1));
+                if (timer_lists_[candidate] != TIMER_NONE)
+                {
+                    list = candidate;
+                    break;
+                }
+            }
+        }
+        if (list == TIMER_NONE)
+        {
+            continue;
+        }
+
+        for (uint16_t index = timer_lists_[list]; index != TIMER_NONE; index = timers_[index].next)
+        {
+            uint64_t expiry = GetTimerExpiry(timers_[index]);
+            if (expiry < earliest)
+            {
+                earliest = expiry;
+            }
+        }
+    }
+
+    bool found = earliest != UINT64_MAX;
+    if (found)
+    {
+        ticks = earliest << TIMER_TICK_SHIFT;
+    }
+
+    __set_PRIMASK(primask);
+    return found;
+}
+
+bool System::SetWakeup(uint64_t ticks)
+{
+    uint64_t now = GetTicks();
+    if (ticks < now + WAKEUP_MARGIN_TICKS)
+    {
+        return false;
+    }
+
+    // The counter overflow wakes us up anyway, a later compare would match too early
+    if (ticks - now > UINT32_MAX)
+    {
+        ticks = now + UINT32_MAX;
+    }
+
+    RTC->MODE0.INTENCLR.reg = RTC_MODE0_INTENCLR_CMP0;
+    RTC->MODE0.COMP[0].reg = static_cast<uint32_t>(ticks);
+    SyncRtc();
+    RTC->MODE0.INTFLAG.reg = RTC_MODE0_INTFLAG_CMP0;
+    RTC->MODE0.INTENSET.reg = RTC_MODE0_INTENSET_CMP0;
+
+    // The synchronization took a few ticks, make sure the compare is still ahead
+    return GetTicks() + 1 < ticks;
+}
+
+System::TimerId System::AddTimer(uint32_t delay_ms, bool periodic, TimerCallback callback)
+{
+    if (!callback)
+    {
+        return INVALID_TIMER;
+    }
+
+    // The current tick is partly over, one more keeps the delay from being short
+    uint32_t delay = MsToTimerTicks(delay_ms);
+    uint64_t expiry = (GetTicks() >> TIMER_TICK_SHIFT) + delay + 1;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    uint16_t index = timer_lists_[TIMER_FREE_LIST];
+    if (index == TIMER_NONE)
+    {
+        __set_PRIMASK(primask);
+        return INVALID_TIMER;
+    }
+    UnlinkTimer(index);
+
+    Timer &timer = timers_[index];
+    timer.callback = callback;
+    timer.period = 0;
+    if (periodic)
+    {
+        // At least one timer tick, 0 would make it a one-shot
+        timer.period = delay > 0 ? delay : 1;
+    }
+    InsertTimer(index, expiry);
+
+    TimerId id = (static_cast<uint16_t>(timer.generation) << 8) | index;
+
+    __set_PRIMASK(primask);
+    return id;
+}
+
+uint32_t System::MsToTimerTicks(uint32_t ms)
+{
+    uint64_t ticks = (static_cast<uint64_t>(ms) * TIMER_FREQUENCY + 999) / 1000;
+    return ticks > MAX_TIMER_DELAY ? MAX_TIMER_DELAY : static_cast<uint32_t>(ticks);
+}
+
+uint64_t System::GetTimerExpiry(const Timer &timer)
+{
+    // Expiries are within MAX_TIMER_DELAY of the wheel, extend the stored 32 bits around it
+    int32_t offset = static_cast<int32_t>(timer.expiry - static_cast<uint32_t>(timer_time_));
+    return timer_time_ + offset;
+}
+
+void System::InsertTimer(uint16_t index, uint64_t expiry)
+{
+    if (expiry < timer_time_)
+    {
+        expiry = timer_time_;
+    }
+    timers_[index].expiry = static_cast<uint32_t>(expiry);
+
+    // Lowest level where the expiry is less than one turn ahead
+    uint8_t level = 0;
+    uint8_t shift = 0;
+    while (level < TIMER_LEVELS - 1 && (expiry >> shift) - (timer_time_ >> shift) >= TIMER_SLOTS)
+    {
+        level++;
+        shift += TIMER_SLOT_BITS;
+    }
+
+    // Beyond the top level, park in its farthest slot and sort again when it cascades
+    uint64_t slot_time = expiry >> shift;
+    uint64_t last_slot_time = (timer_time_ >> shift) + TIMER_SLOTS - 1;
+    if (slot_time > last_slot_time)
+    {
+        slot_time = last_slot_time;
+    }
+
+    LinkTimer(index, level * TIMER_SLOTS + (slot_time & (TIMER_SLOTS - 1)));
+}
+
+void System::LinkTimer(uint16_t index, uint16_t list)
+{
+    Timer &timer = timers_[index];
+    timer.list = list;
+    timer.prev = TIMER_NONE;
+    timer.next = timer_lists_[list];
+    if (timer.next != TIMER_NONE)
+    {
+        timers_[timer.next].prev = index;
+    }
+    timer_lists_[list] = index;
+
+    if (list < TIMER_EXPIRED_LIST)
+    {
+        timer_level_count_[list / TIMER_SLOTS]++;
+    }
+}
+
+void System::UnlinkTimer(uint16_t index)
+{
+    Timer &timer = timers_[index];
+    if (timer.prev != TIMER_NONE)
+    {
+        timers_[timer.prev].next = timer.next;
+    }
+    else
+    {
+        timer_lists_[timer.list] = timer.next;
+    }
+    if (timer.next != TIMER_NONE)
+    {
+        timers_[timer.next].prev = timer.prev;
+    }
+
+    if (timer.list < TIMER_EXPIRED_LIST)
+    {
+        timer_level_count_[timer.list / TIMER_SLOTS]--;
+    }
+    timer.list = TIMER_NONE;
+}
+
+void System::FreeTimer(uint16_t index)
+{
+    // Invalidate handles still pointing to this entry
+    timers_[index].generation = (timers_[index].generation + 1) & 0x7F;
+    LinkTimer(index, TIMER_FREE_LIST);
+}
+
+void System::CascadeTimers(uint8_t level, uint16_t slot)
+{
+    // Re-inserted timers always land on a lower level (or a later top level slot)
+    uint16_t list = level * TIMER_SLOTS + slot;
+    while (timer_lists_[list] != TIMER_NONE)
+    {
+        uint16_t index = timer_lists_[list];
+        UnlinkTimer(index);
+        InsertTimer(index, GetTimerExpiry(timers_[index]));
+    }
+}
+
+uint64_t System::GetNextTimerTick(uint64_t tick, uint64_t now)
+{
+    // Skip stretches where the lower levels are empty, straight to the next cascade
+    uint8_t level = 0;
+    while (level < TIMER_LEVELS && timer_level_count_[level] == 0)
+    {
+        level++;
+    }
+
+    uint64_t next = now + 1;
+    if (level < TIMER_LEVELS)
+    {
+        uint8_t shift = TIMER_SLOT_BITS * level;
+        next = ((tick >> shift) + 1) << shift;
+    }
+
+    // Never run ahead of the timebase
+    return next < now + 1 ? next : now + 1;
+}
+
+void System::RunExpiredTimers()
+{
+    uint32_t primask = __get_PRIMASK();
+
+    while (true)
+    {
+        __disable_irq();
+
+        uint16_t index = timer_lists_[TIMER_EXPIRED_LIST];
+        if (index == TIMER_NONE)
+        {
+            break;
+        }
+        UnlinkTimer(index);
+
+        Timer &timer = timers_[index];
+        TimerCallback callback = timer.callback;
+        if (timer.period > 0)
+        {
+            // Keep the phase: a late periodic timer skips the periods it missed
+            // rather than running once for each, or being clamped to now
+            uint64_t expiry = GetTimerExpiry(timer) + timer.period;
+            if (expiry < timer_time_)
+            {
+                expiry += (timer_time_ - expiry + timer.period - 1) / timer.period * timer.period;
+            }
+            InsertTimer(index, expiry);
+        }
+        else
+        {
+            FreeTimer(index);
+        }
+
+        // The callback may start or stop timers, including this one
+        __set_PRIMASK(primask);
+        callback();
+    }
+
+    __set_PRIMASK(primask);
+}
+
+}
@@ -66,10 +66,57 @@ bool AT24XX::ReadPage(uint16_t address, uint8_t *data, uint32_t length)
 
 bool AT24XX::WaitForWriteCompletion()
 {
-    System::DelayMs(10); // EEPROM write time (10ms should be enough for most EEPROMs)
+    System::DelayMs(WRITE_CYCLE_MS);
     return true;
 }
 
+uint32_t AT24XX::FillAddress(uint16_t address, uint8_t *buffer) const
+{
+    if (address_size_ == 1)
+    {
+        buffer[0] = address & 0xFF;
+        return 1;
+    }
+    buffer[0] = (address >> 8) & 0xFF; // MSB
+    buffer[1] = address & 0xFF;        // LSB
+    return 2;
+}
+
+Task<bool> AT24XX::WriteAsync(uint16_t address, const uint8_t *data, uint32_t length)
+{
+    // Memory address followed by one page of data
+    uint8_t buffer[2 + MAX_PAGE_SIZE];
+    uint32_t page_size = std::min(page_size_, MAX_PAGE_SIZE);
+
+    uint32_t bytes_written = 0;
+    while (bytes_written < length)
+    {
+        uint16_t page_address = address + bytes_written;
+        uint32_t remaining_in_page = page_size - (page_address % page_size);
+        uint32_t write_length = std::min(length - bytes_written, remaining_in_page);
+
+        uint32_t header = FillAddress(page_address, buffer);
+        std::copy(data + bytes_written, data + bytes_written + write_length, buffer + header);
+
+        if (!co_await i2c_.TransferAsync(device_address_, buffer, header + write_length))
+        {
+            co_return false;
+        }
+        bytes_written += write_length;
+
+        // The EEPROM does not respond until the page is programmed
+        co_await System::Sleep(WRITE_CYCLE_MS);
+    }
+    co_return true;
+}
+
+Task<bool> AT24XX::ReadAsync(uint16_t address, uint8_t *data, uint32_t length)
+{
+    uint8_t header[2];
+    uint32_t header_length = FillAddress(address, header);
+    co_return co_await i2c_.TransferAsync(device_address_, header, header_length, data, length);
+}
+
 AT24XX AT24XX::AT24C32(I2C &i2c, uint8_t device_address)
 {
     return AT24XX(i2c, device_address, 4096, 32, 2); // 4KB (4096 bytes), 32-byte page size
@@ -1,6 +1,8 @@
 #include <cstdint>
 
 #include "minisamd21/AdcInput.hpp"
+#include "minisamd21/Executor.hpp"
+#include "minisamd21/FastPin.hpp"
 #include "minisamd21/I2C.hpp"
 #include "minisamd21/Pin.hpp"
 #include "minisamd21/Sleep.hpp"
@@ -16,21 +18,37 @@ constexpr uint32_t LED_PIN = 23;
 
 using namespace minisamd21;
 
-void ButtonCallback()
+void ChargeStateCallback()
+{
+    // Add charge state change functionality here
+}
+
+// Blink the LED once per button press, the wait leaves the core free
+Task<> BlinkLed(Pin &led)
 {
-    // Use the global LED instead of creating a new one in the interrupt
-    Pin led2(Pin::PortName::PORTA, LED_PIN);
-    led2.Init(Pin::Mode::OUTPUT);
     for (int i = 0; i < 4; ++i)
     {
-        led2.Toggle();
-        System::DelayMs(50);
+        led.Toggle();
+        co_await System::Sleep(50);
     }
 }
 
-void ChargeStateCallback()
+// Heartbeat of the LED and periodic readings
+Task<> Heartbeat(Pin &led, DS3231 &ds3231, AdcInput &adc)
 {
-    // Add charge state change functionality here
+    while (1)
+    {
+        led.Write(1);
+        co_await System::Sleep(500);
+        led.Write(0);
+        co_await System::Sleep(500);
+
+        [[maybe_unused]] DS3231::Time time = ds3231.GetTime();
+        // char read_hello[15] = {0};
+        // eeprom.Read(0x0, (uint8_t *)read_hello, 15);
+
+        [[maybe_unused]] uint16_t adc_value = co_await adc.ReadAsync();
+    }
 }
 
 int main()
@@ -41,9 +59,9 @@ int main()
     Pin button(Pin::PortName::PORTA, BUTTON_PIN);
     Pin chargeState(Pin::PortName::PORTA, CHARGE_STATE_PIN);
 
-    OutShiftRegister sr(Pin(Pin::PortName::PORTA, 17),
-                        Pin(Pin::PortName::PORTA, 18),
-                        Pin(Pin::PortName::PORTA, 19));
+    OutShiftRegister sr(FastPin<Pin::PortName::PORTA, 17>{},
+                        FastPin<Pin::PortName::PORTA, 18>{},
+                        FastPin<Pin::PortName::PORTA, 19>{});
     sr.Init();
     sr.WriteByte(0b10101010);
 
@@ -55,7 +73,14 @@ int main()
     Sleep::Init();
 
     // Set up button interrupt - should trigger when button is pressed (FALLING edge)
-    button.AttachInterrupt(Pin::InterruptMode::FALLING, ButtonCallback, true);
+    // The handler reaches the LED through the delegate, no Pin is rebuilt in the interrupt.
+    // It is deferred and debounced: the interrupt only queues the edge, Executor::Run()
+    // reports the press once the line stayed quiet for DEBOUNCE_MS and starts the blinking.
+    auto blink_led = [&led](const Pin::Event &)
+    {
+        Executor::Spawn(BlinkLed(led));
+    };
+    button.AttachDebouncedInterrupt(Pin::InterruptMode::FALLING, blink_led, Pin::DEBOUNCE_MS, true);
     chargeState.AttachInterrupt(Pin::InterruptMode::FALLING, ChargeStateCallback);
 
     // Brightness control
@@ -94,28 +119,14 @@ int main()
     // const char *hello = "Hello, World!";
     // eeprom.Write(0x0, (uint8_t *)hello, 15);
 
-    int32_t sleep_counter = 0;
+    Executor::Spawn(Heartbeat(led, ds3231, adc));
 
-    // Main program loop
+    // Main program loop, everything runs from the executor and the core sleeps in between
     while (1)
     {
-        int32_t delay = 500;
-        led.Write(1);
-        System::DelayMs(delay);
-        led.Write(0);
-        System::DelayMs(delay);
-
-        [[maybe_unused]] DS3231::Time time = ds3231.GetTime();
-        // char read_hello[15] = {0};
-        // eeprom.Read(0x0, (uint8_t *)read_hello, 15);
-
-        [[maybe_unused]] uint16_t adc_value = adc.Read();
-        System::DelayMs(10);
-
-        sleep_counter++;
-        if (sleep_counter >= 3)
+        Executor::Run();
+        if (Executor::IsIdle())
         {
-            sleep_counter = 0;
             sr.DeInit();
             Sleep::SleepNow();
             sr.Init();
@@ -20,14 +20,14 @@ extern void SysTick_Handler(void); // Handled in System.cpp
 void PM_Handler(void) __attribute__((weak, alias("Default_Handler")));
 void SYSCTRL_Handler(void) __attribute__((weak, alias("Default_Handler")));
 void WDT_Handler(void) __attribute__((weak, alias("Default_Handler")));
-void RTC_Handler(void) __attribute__((weak, alias("Default_Handler")));
+extern void RTC_Handler(void); // Handled in System.cpp
 extern void EIC_Handler(void); // Handled in Pin.cpp
 void NVMCTRL_Handler(void) __attribute__((weak, alias("Default_Handler")));
-void DMAC_Handler(void) __attribute__((weak, alias("Default_Handler")));
+extern void DMAC_Handler(void); // Handled in Dma.cpp
 void USB_Handler(void) __attribute__((weak, alias("Default_Handler")));
 void EVSYS_Handler(void) __attribute__((weak, alias("Default_Handler")));
-void SERCOM0_Handler(void) __attribute__((weak, alias("Default_Handler")));
-void SERCOM1_Handler(void) __attribute__((weak, alias("Default_Handler")));
+extern void SERCOM0_Handler(void); // Handled in I2C.cpp
+extern void SERCOM1_Handler(void); // Handled in I2C.cpp
 void SERCOM2_Handler(void) __attribute__((weak, alias("Default_Handler")));
 void SERCOM3_Handler(void) __attribute__((weak, alias("Default_Handler")));
 void SERCOM4_Handler(void) __attribute__((weak, alias("Default_Handler")));
@@ -40,27 +40,89 @@ void TC4_Handler(void) __attribute__((weak, alias("Default_Handler")));
 void TC5_Handler(void) __attribute__((weak, alias("Default_Handler")));
 void TC6_Handler(void) __attribute__((weak, alias("Default_Handler")));
 void TC7_Handler(void) __attribute__((weak, alias("Default_Handler")));
-void ADC_Handler(void) __attribute__((weak, alias("Default_Handler")));
+extern void ADC_Handler(void); // Handled in AdcInput.cpp
 void AC_Handler(void) __attribute__((weak, alias("Default_Handler")));
 void DAC_Handler(void) __attribute__((weak, alias("Default_Handler")));
 void PTC_Handler(void) __attribute__((weak, alias("Default_Handler")));
 void I2S_Handler(void) __attribute__((weak, alias("Default_Handler")));
 
 
-void Reset_Handler(void) {
-    /* Copy initialized data from flash to RAM */
-    uint32_t* src = &_etext;
-    uint32_t* dst = &_sdata;
-    while (dst < &_edata) {
+/* Static constructors, walked directly since libc is not linked */
+extern void (*__preinit_array_start[])(void);
+extern void (*__preinit_array_end[])(void);
+extern void (*__init_array_start[])(void);
+extern void (*__init_array_end[])(void);
+
+/* Core cycles from reset to main(), read by System::GetBootCycles() */
+uint32_t boot_cycles;
+
+/* Copy words from flash to RAM, 16 bytes per LDM/STM pair */
+static inline __attribute__((always_inline)) void CopyWords(uint32_t *dst, const uint32_t *src, uint32_t words) {
+    uint32_t blocks = words >> 2;
+    if (blocks) {
+        /* r7 is the frame pointer at -O0, stay below it */
+        __asm__ volatile(
+            "1:                               \n"
+            "   ldmia %[src]!, {r3-r6}        \n"
+            "   stmia %[dst]!, {r3-r6}        \n"
+            "   subs %[blocks], #1            \n"
+            "   bne 1b                        \n"
+            : [src] "+l"(src), [dst] "+l"(dst), [blocks] "+l"(blocks)
+            :
+            : "r3", "r4", "r5", "r6", "cc", "memory");
+    }
+    words &= 3;
+    while (words--) {
         *dst++ = *src++;
     }
+}
 
-    /* Clear the BSS section */
-    dst = &_sbss;
-    while (dst < &_ebss) {
+/* Clear words in RAM, 16 bytes per STM */
+static inline __attribute__((always_inline)) void ZeroWords(uint32_t *dst, uint32_t words) {
+    uint32_t blocks = words >> 2;
+    if (blocks) {
+        __asm__ volatile(
+            "   movs r3, #0                   \n"
+            "   movs r4, #0                   \n"
+            "   movs r5, #0                   \n"
+            "   movs r6, #0                   \n"
+            "1:                               \n"
+            "   stmia %[dst]!, {r3-r6}        \n"
+            "   subs %[blocks], #1            \n"
+            "   bne 1b                        \n"
+            : [dst] "+l"(dst), [blocks] "+l"(blocks)
+            :
+            : "r3", "r4", "r5", "r6", "cc", "memory");
+    }
+    words &= 3;
+    while (words--) {
         *dst++ = 0;
     }
-    
+}
+
+void Reset_Handler(void) {
+    /* Free-running SysTick from the reset clock to measure the boot time */
+    SysTick->LOAD = SysTick_LOAD_RELOAD_Msk;
+    SysTick->VAL = 0;
+    SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_ENABLE_Msk;
+
+    /* Copy initialized data (and RAM functions) from flash to RAM */
+    CopyWords(&_sdata, &_etext, &_edata - &_sdata);
+
+    /* Clear the BSS section, .noinit after it is left alone */
+    ZeroWords(&_sbss, &_ebss - &_sbss);
+
+    /* Run C++ static constructors */
+    for (void (**init)(void) = __preinit_array_start; init < __preinit_array_end; init++) {
+        (*init)();
+    }
+    for (void (**init)(void) = __init_array_start; init < __init_array_end; init++) {
+        (*init)();
+    }
+
+    /* SysTick counts down from its reload value */
+    boot_cycles = SysTick_LOAD_RELOAD_Msk - SysTick->VAL;
+
    // Clock needs to be initialized inside main()
     
     /* Call main */